@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+
+#define ARENA_BLOCK_SIZE	(1024 * 1024)
+
+struct ArenaStats
+{
+	size_t	allocations; // requests served by the arena
+	size_t	bytes; // bytes handed out
+	size_t	blocks; // allocations made from the upstream resource
+	size_t	reserved; // bytes obtained from the upstream resource
+
+	ArenaStats& operator+=(const ArenaStats& other) {
+		allocations += other.allocations;
+		bytes += other.bytes;
+		blocks += other.blocks;
+		reserved += other.reserved;
+		return *this;
+	}
+};
+
+// Bump allocator: deallocate is a no-op and everything is released at once by reset()
+// or the destructor. Usable by any std::pmr container.
+class Arena : public std::pmr::memory_resource
+{
+	public:
+		Arena(size_t blockSize = ARENA_BLOCK_SIZE, std::pmr::memory_resource* upstream = std::pmr::new_delete_resource());
+		~Arena();
+
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		void				reset();
+		const ArenaStats&	getStats() const;
+
+	private:
+		struct Block
+		{
+			Block*	next;
+			size_t	size;
+		};
+
+		std::pmr::memory_resource*	upstream;
+		size_t						blockSize;
+		Block*						blocks; // most recent first
+		char*						cursor;
+		char*						end;
+		ArenaStats					stats;
+
+		void	addBlock(size_t minSize);
+		void	releaseBlocks(Block* block);
+
+		void*	do_allocate(size_t bytes, size_t alignment) override;
+		void	do_deallocate(void* p, size_t bytes, size_t alignment) override;
+		bool	do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+};
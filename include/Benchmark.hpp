@@ -0,0 +1,5 @@
+#pragma once
+
+// Headless benchmark mode, started with `./scop --bench [--threads max] [--trace file.json] [--baseline previous.json] [file.obj ...]`
+// Results are written to stdout as a JSON document.
+int	runBenchmark(int argc, char** argv);
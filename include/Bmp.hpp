@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <string>
+#include "struct.hpp"
+
+// A BMP file mapped read only, its pixel array is handed to GL as is (GL_BGR / GL_BGRA).
+// Only uncompressed 24 and 32 bit images are handled, palettes, RLE and unusual channel
+// masks are left to stb_image.
+// Bottom-up files, the common case, already follow the GL row order and are contiguous.
+class BmpImage
+{
+	public:
+		BmpImage();
+		~BmpImage();
+		BmpImage(const BmpImage&) = delete;
+		BmpImage&	operator=(const BmpImage&) = delete;
+
+		bool					open(const char* filePathName);
+		void					close();
+
+		int						getWidth() const;
+		int						getHeight() const;
+		int						getChannels() const; // bytes per pixel, 3 or 4
+		GLenum					getFormat() const;
+		size_t					getRowStride() const; // padded to 4 bytes, a valid GL_UNPACK_ALIGNMENT
+		bool					isBottomUp() const;
+		const unsigned char*	getPixels() const; // first row in file order
+		const unsigned char*	getRow(int y) const; // y = 0 is the bottom row
+
+	private:
+		void*					mapping;
+		size_t					mappingSize;
+		const unsigned char*	pixels;
+		int						width;
+		int						height;
+		int						channels;
+		size_t					rowStride;
+		bool					bottomUp;
+};
+
+bool	isBmpFile(const std::string& path);
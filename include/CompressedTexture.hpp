@@ -0,0 +1,37 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include "struct.hpp"
+
+enum BlockFormat
+{
+	BLOCK_BC1, // RGB, 8 bytes per 4x4 block
+	BLOCK_BC3, // RGBA, 16 bytes
+	BLOCK_BC7, // RGBA, 16 bytes
+};
+
+struct CompressedLevel
+{
+	size_t	offset; // in CompressedImage::data
+	size_t	size;
+	int		width;
+	int		height;
+};
+
+// A block compressed image with its mip chain, as stored in a DDS or KTX2 container
+struct CompressedImage
+{
+	BlockFormat						format;
+	int								width;
+	int								height;
+	std::vector<CompressedLevel>	levels;
+	std::vector<unsigned char>		data;
+};
+
+bool	isCompressedTextureFile(const std::string& path);
+bool	loadCompressedTexture(const char* filePathName, CompressedImage& image);
+GLenum	compressedInternalFormat(BlockFormat format, bool srgb);
+bool	isCompressedFormatSupported(BlockFormat format);
+size_t	compressedLevelSize(BlockFormat format, int width, int height);
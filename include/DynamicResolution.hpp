@@ -0,0 +1,27 @@
+#pragma once
+
+#define DYNAMIC_RESOLUTION_TARGET_MS	16.6
+#define DYNAMIC_RESOLUTION_SMOOTHING	0.2 // weight of the newest GPU time
+#define DYNAMIC_RESOLUTION_MARGIN		0.9 // aims under the target so a spike does not go over it
+#define DYNAMIC_RESOLUTION_STEP			0.05f // the scale moves in steps, the target is not reallocated for tiny changes
+#define DYNAMIC_RESOLUTION_SETTLE		6 // frames after a change before the next one, GPU times arrive a few frames late
+
+// Picks the render scale that holds the GPU time of a frame under a target.
+// The cost of a frame is taken as proportional to its pixel count, the square of the scale:
+// the scale drops to the estimate at once when over budget and climbs back one step at a time.
+class DynamicResolution
+{
+	public:
+		DynamicResolution();
+
+		float	update(double gpuMs, double targetMs, float minScale, float maxScale); // returns the new scale
+		float	getScale() const;
+		double	getGpuMs() const; // smoothed
+		double	getHeadroomMs() const; // target minus the smoothed GPU time, negative when over
+
+	private:
+		float	scale;
+		double	gpuMs;
+		double	headroomMs;
+		int		settle;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Reports files written in a directory, polled once per frame without blocking (inotify).
+// Editors that save through a temporary file and a rename are caught as well.
+class FileWatcher
+{
+	public:
+		FileWatcher(const char* directory);
+		~FileWatcher();
+		FileWatcher(const FileWatcher&) = delete;
+		FileWatcher&	operator=(const FileWatcher&) = delete;
+
+		bool	poll(std::vector<std::string>& changed); // file names, relative to the directory
+
+	private:
+		int		fd; // -1 when watching is unavailable
+		int		watch;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <chrono>
+
+// Spaces frames evenly at a target rate. Frame slots follow a fixed timeline rather than
+// "now + period", so sleep overshoot does not accumulate into a lower rate; the end of each
+// wait spins because sleeps are only accurate to a scheduler tick.
+class FramePacer
+{
+	public:
+		FramePacer();
+
+		void	setRate(int framesPerSecond); // 0 disables pacing
+		void	wait();
+
+	private:
+		typedef std::chrono::steady_clock	clock;
+
+		clock::duration		period;
+		clock::time_point	nextFrame;
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "struct.hpp"
+#include "Meshlet.hpp"
+#include "TextureCache.hpp"
+#include "../imgui/imgui.h"
+
+// Per-frame shader data, std140 layout of the FrameUniforms block
+struct FrameUniforms
+{
+	Mat4	model;
+	Mat4	view;
+	Mat4	projection;
+	Vec3	lightPos;
+	float	transitionFactor;
+	Vec3	lightColor;
+	int		showLight;
+	Vec3	objectColor;
+	int		showGradient;
+	Vec3	viewPos;
+	float	pad0;
+	Vec3	gradientStartColor;
+	float	pad1;
+	Vec3	gradientEndColor;
+	float	pad2;
+};
+static_assert(sizeof(FrameUniforms) == 288, "FrameUniforms must match the std140 block");
+
+typedef std::function<void()>	RenderCommand;
+
+// Everything the render thread needs to draw one frame, built by the main thread
+struct FramePacket
+{
+	FrameUniforms				uniforms;
+	uint						shaderFeatures;
+	bool						showWireframe;
+	bool						frustumCulling;
+	bool						backfaceCulling;
+	bool						occlusionCulling;
+	bool						useGpuCulling;
+	bool						vsync;
+	int							framebufferWidth;
+	int							framebufferHeight;
+	float						renderScale; // the highest one with dynamicResolution
+	int							msaaSamples;
+	bool						dynamicResolution;
+	float						targetFrameMs;
+	std::vector<RenderCommand>	commands; // GL work requested by the UI, run before drawing
+
+	// copy of the ImGui output, the lists are allocated and freed on the main thread only
+	ImDrawData					drawData;
+	std::vector<ImDrawList*>	drawLists;
+
+	FramePacket();
+	~FramePacket();
+	void	setDrawData(const ImDrawData* source);
+};
+
+// Published by the render thread after every frame for the UI
+struct RenderStatus
+{
+	MeshletCullStats	cullStats;
+	size_t				meshletCount;
+	bool				streamPersistent;
+	uint				streamStalls;
+	bool				streaming; // progressive model load in progress
+	float				streamProgress;
+	bool				textureLoading;
+	float				textureProgress;
+	TextureCacheStats	cacheStats;
+	size_t				cacheBudget;
+	uint				shaderVariantsReady;
+	bool				shadersCompiling;
+	bool				shadersReloading;
+	std::string			shaderError;
+	std::string			computeShaderError;
+	Vec3				modelCenterOffset;
+	int					renderWidth; // offscreen target
+	int					renderHeight;
+	int					renderSamples;
+	int					maxSamples;
+	float				renderScale; // applied to the last frame
+	double				gpuMs; // last measured GPU time of a frame
+	double				headroomMs; // dynamic resolution target minus the smoothed GPU time
+};
+
+// Hands frames from the main thread to the render thread. There are two packets so the main
+// thread builds frame N + 1 while frame N is drawn; it only waits when it gets two frames ahead.
+class FrameQueue
+{
+	public:
+		FrameQueue();
+
+		// main thread
+		FramePacket&	beginWrite();
+		void			submit();
+		void			readStatus(RenderStatus& status);
+
+		// render thread
+		bool			acquire(FramePacket*& packet);
+		void			release();
+		void			publishStatus(const RenderStatus& status);
+
+		void			stop();
+		bool			isStopped();
+
+	private:
+		std::mutex				mutex;
+		std::condition_variable	changed;
+		FramePacket				packets[2];
+		int						writeIndex;
+		int						readyIndex; // submitted and not acquired yet, -1 when none
+		int						drawingIndex; // -1 when the render thread is idle
+		bool					stopped;
+		RenderStatus			status;
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include "struct.hpp"
+#include "Meshlet.hpp"
+
+#define CULL_STATS_READBACKS	3 // frames the counters may lag behind before a frame goes unread
+
+// Meshlet culling on the GPU (GL 4.3 compute): frustum, normal cone and Hi-Z occlusion
+// against the depth pyramid of the previous frame. The compute pass writes the
+// indirect draw buffer and the draw count, the CPU never sees the visible list.
+// Commands are binned per texture batch so each batch is drawn with one indirect call.
+class GpuCulling
+{
+	public:
+		GpuCulling();
+		~GpuCulling();
+
+		static bool	isSupported();
+
+		void	uploadMeshlets(const std::vector<Meshlet>& meshlets, const std::vector<uint>& materialBatches);
+		void	appendMeshlets(const std::vector<Meshlet>& meshlets, const std::vector<uint>& materialBatches); // only the ones past the uploaded count
+		void	cull(const Mat4& model, const Mat4& viewProjection, const Vec3& cameraPos, bool frustumCulling, bool backfaceCulling, bool occlusionCulling);
+		void	draw(uint batch);
+		void	buildDepthPyramid(int width, int height, const Mat4& modelViewProjection);
+		void	invalidateDepthPyramid();
+		bool	reloadPrograms(std::string& error);
+
+		const MeshletCullStats&	getStats() const;
+
+	private:
+		struct GpuMeshlet
+		{
+			float	sphere[4];
+			float	cone[4];
+			uint	firstIndex;
+			uint	indexCount;
+			uint	material;
+			uint	batch;
+		};
+
+		uint	cullProgram;
+		uint	pyramidProgram;
+
+		uint	meshletBuffer;
+		uint	commandBuffer;
+		uint	counterBuffer;
+		uint	batchBuffer;
+		uint	meshletCount;
+		uint	meshletCapacity; // of meshletBuffer and commandBuffer, grown geometrically
+		uint	submittedTriangles;
+		bool	indirectCount;
+
+		// batch b owns the command slots [batchOffsets[b], batchOffsets[b] + batchSizes[b])
+		std::vector<uint>	batchOffsets;
+		std::vector<uint>	batchSizes;
+		std::vector<uint>	uploadedBatches; // materialBatches the uploaded meshlets were binned with
+
+		// depth pyramid
+		uint	depthTexture;
+		uint	pyramidTexture;
+		int		pyramidWidth;
+		int		pyramidHeight;
+		int		pyramidLevels;
+		bool	pyramidValid;
+		Mat4	previousModelViewProjection;
+
+		// the counters are copied out after each dispatch, a copy is read once its fence signals
+		uint				statsBuffers[CULL_STATS_READBACKS];
+		GLsync				statsFences[CULL_STATS_READBACKS];
+		int					statsHead; // next slot to fill, also the oldest pending one
+		MeshletCullStats	stats;
+
+		void	readStats();
+		void	copyStats();
+		void	dropStats();
+		void	reserveMeshlets(uint count);
+		void	resizePyramid(int width, int height);
+};
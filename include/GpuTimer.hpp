@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "struct.hpp"
+
+#define GPU_TIMER_QUERIES	4 // frames the GPU may lag behind before a frame goes unmeasured
+
+// GPU time of a stretch of commands, measured with GL_TIME_ELAPSED queries.
+// Results are read a few frames later once available, never waited for.
+class GpuTimer
+{
+	public:
+		GpuTimer();
+		~GpuTimer();
+		GpuTimer(const GpuTimer&) = delete;
+		GpuTimer&	operator=(const GpuTimer&) = delete;
+
+		void	begin();
+		void	end();
+		bool	poll(double& ms); // true with the latest result when a new one came in
+
+	private:
+		uint	queries[GPU_TIMER_QUERIES];
+		bool	pending[GPU_TIMER_QUERIES];
+		int		head; // next query to use, also the oldest pending one
+		bool	active;
+		bool	fresh;
+		double	lastMs;
+
+		void	collect();
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "struct.hpp"
+
+#define JOB_EXTERNAL_QUEUES	8 // threads outside the pool with a deque of their own, the others share one
+
+struct Job;
+typedef std::shared_ptr<Job>	JobHandle;
+
+// Time spent in the jobs of one name, summed over every thread
+struct JobStats
+{
+	std::string	name;
+	uint		count;
+	double		totalMs;
+	double		maxMs;
+};
+
+// Work stealing job pool. Every worker owns a deque: it pushes and pops its own jobs at the back
+// and, once it runs dry, steals the oldest job at the front of another one. A thread outside the pool
+// gets its own deque the first time it submits or waits, the workers steal from it as well.
+// A job starts once the jobs it depends on are finished; a thread waiting for a job runs the jobs
+// of its own deque meanwhile, it never steals while there are workers, so a long job from elsewhere cannot stall it.
+// The thread count includes the caller of wait() and parallelFor(): 1 runs everything inline.
+class JobSystem
+{
+	public:
+		explicit JobSystem(uint threadCount = 0); // 0 for one thread per core
+		~JobSystem();
+		JobSystem(const JobSystem&) = delete;
+		JobSystem&	operator=(const JobSystem&) = delete;
+
+		JobHandle	submit(const char* name, std::function<void()> function, const std::vector<JobHandle>& dependencies = {});
+		void		wait(const JobHandle& job); // rethrows what the job threw
+		void		wait(const std::vector<JobHandle>& jobs);
+
+		// body(begin, end) over [0, count) in chunks of grain items, returns once every chunk ran
+		void		parallelFor(const char* name, size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+		void		resize(uint threadCount); // only while no job is in flight
+		uint		getThreadCount() const;
+		void		collectStats(std::vector<JobStats>& stats); // slowest first
+		void		resetStats();
+
+	private:
+		// One per worker, then one per registered thread outside the pool; index 0 is shared by the
+		// outside threads that found every slot taken
+		struct Queue
+		{
+			std::mutex								mutex;
+			std::deque<JobHandle>					jobs;
+			std::mutex								statsMutex;
+			std::unordered_map<const char*, JobStats>	stats; // names are string literals
+		};
+
+		std::vector<std::unique_ptr<Queue>>	queues; // all allocated by start(), never resized while running
+		uint								threadCount;
+		std::atomic<uint>					externalQueues; // registered so far
+		uint								generation; // unique per start(), older registrations are stale
+		std::vector<std::thread>			workers;
+		std::mutex							sleepMutex;
+		std::condition_variable				wake;
+		std::atomic<int>					queuedJobs;
+		bool								stopping;
+
+		void		start(uint threadCount);
+		void		stop();
+		void		workerLoop(uint index);
+		uint		currentQueue();
+		uint		activeQueues() const;
+		void		schedule(const JobHandle& job);
+		JobHandle	pop(uint index);
+		JobHandle	steal(uint thief);
+		void		execute(const JobHandle& job, uint index);
+		void		record(const char* name, double ms, uint index);
+};
+
+// Shared by the subsystems, sized to the machine on first use
+JobSystem&	jobSystem();
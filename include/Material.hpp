@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include <vector>
+#include "struct.hpp"
+
+#define MATERIAL_MAX_COUNT	256 // size of the Materials uniform block array
+
+// Subset of an MTL material the renderer uses. Material 0 is the default one,
+// drawn with the object color picked in the UI.
+struct Material
+{
+	std::string	name;
+	Vec3		diffuse;	// Kd
+	Vec3		specular;	// Ks
+	float		shininess;	// Ns
+	std::string	diffuseMap;	// map_Kd, resolved against the .mtl directory, empty when untextured
+
+	Material();
+};
+
+// Contiguous run of the index buffer drawn with one material
+struct MaterialRange
+{
+	uint	material;
+	uint	firstIndex;
+	uint	indexCount;
+};
+
+// std140 element of the Materials uniform block
+struct GpuMaterial
+{
+	Vec3	diffuse;
+	float	shininess;
+	Vec3	specular;
+	int		layer; // in the texture array of the material's batch, -1 samples the global texture
+};
+static_assert(sizeof(GpuMaterial) == 32, "GpuMaterial must match the std140 block");
+
+std::string	directoryOf(const std::string& path);
+bool		loadMtlFile(const char* filePathName, std::vector<Material>& materials);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "struct.hpp"
+#include "Material.hpp"
+#include "Texture.hpp"
+#include "CompressedTexture.hpp"
+#include "Bmp.hpp"
+
+#define MATERIAL_TEXTURE_UNIT	2 // texture unit of the sampler2DArray, unit 0 stays the global texture
+
+// map_Kd textures packed into GL_TEXTURE_2D_ARRAY layers, one array per image size and format
+// (channel count, or block format and mip count for DDS / KTX2 files).
+// Every array is a draw batch: a model whose textures share one size is drawn with a single multi-draw.
+class MaterialTextures
+{
+	public:
+		MaterialTextures();
+		~MaterialTextures();
+
+		MaterialTextures(const MaterialTextures&) = delete;
+		MaterialTextures& operator=(const MaterialTextures&) = delete;
+
+		void	setSrgb(bool srgb);
+		void	clear();
+		void	update(const std::vector<Material>& materials, std::vector<GpuMaterial>& gpuMaterials, std::vector<uint>& materialBatches);
+		uint	getBatchCount() const;
+		void	bind(uint batch) const;
+
+	private:
+		struct TextureArray
+		{
+			int							width;
+			int							height;
+			TextureFormat				format;
+			bool						compressed;
+			int							levels;
+			uint						texture;
+			std::vector<std::string>	layers; // map_Kd path of every layer
+			bool						dirty; // layers were added since the upload
+		};
+
+		struct Location
+		{
+			int		array; // -1 when the image could not be loaded
+			int		layer;
+		};
+
+		bool								srgb;
+		std::vector<TextureArray>			arrays;
+		std::map<std::string, Location>		locations;
+
+		Location	addTexture(const std::string& path);
+		void		upload(TextureArray& array);
+		void		uploadCompressed(TextureArray& array);
+		bool		uploadBmp(const TextureArray& array, size_t layer);
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+#include "struct.hpp"
+
+// Host memory by owner. Parser scratch, decoded textures and ImGui are hooked at their allocator,
+// the mesh is measured after every load since its vectors use the default allocator.
+enum MemoryCategory
+{
+	MEMORY_PARSER_SCRATCH, // OBJ pools, line buffer, dedup tables
+	MEMORY_MESH, // host copy of the loaded mesh and the streaming window
+	MEMORY_TEXTURES, // stb_image decode buffers and mapped BMP files
+	MEMORY_UI, // ImGui
+	MEMORY_CATEGORY_COUNT,
+};
+
+struct MemoryCategoryStats
+{
+	size_t	bytes;
+	size_t	peakBytes; // since the last resetMemoryPeaks()
+	size_t	allocations; // currently live
+};
+
+void				memoryAllocated(MemoryCategory category, size_t bytes);
+void				memoryFreed(MemoryCategory category, size_t bytes);
+void				setMemoryUsage(MemoryCategory category, size_t bytes); // for measured categories
+void				resetMemoryPeaks();
+MemoryCategoryStats	getMemoryStats(MemoryCategory category);
+const char*			memoryCategoryName(MemoryCategory category);
+
+// malloc family with a small header remembering the size, for C style allocator hooks
+void*	trackedMalloc(MemoryCategory category, size_t size);
+void*	trackedRealloc(MemoryCategory category, void* pointer, size_t size);
+void	trackedFree(void* pointer);
+
+// new / delete counted under category, meant as the upstream of arenas and pmr containers
+std::pmr::memory_resource*	trackedResource(MemoryCategory category);
+
+// VRAM registry: every GL buffer and texture the engine allocates, by GL name
+enum GpuResourceKind
+{
+	GPU_BUFFER,
+	GPU_TEXTURE,
+	GPU_RENDERBUFFER,
+};
+
+struct GpuResourceUsage
+{
+	const char*	label;
+	uint		count;
+	size_t		bytes;
+};
+
+void	trackGpuResource(GpuResourceKind kind, uint name, const char* label, size_t bytes); // replaces the previous size
+void	untrackGpuResource(GpuResourceKind kind, uint name);
+void	collectGpuUsage(std::vector<GpuResourceUsage>& usage); // totals by label, largest first
+size_t	textureStorageBytes(GLenum internalFormat, int width, int height, int layers, int levels);
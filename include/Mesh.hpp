@@ -0,0 +1,42 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include "struct.hpp"
+#include "Meshlet.hpp"
+#include "Material.hpp"
+#include "Arena.hpp"
+
+// CPU side geometry of a loaded model, laid out the way it is uploaded to the GPU
+struct Mesh
+{
+	std::vector<Vec3>			positions;
+	std::vector<TextureCoord>	texcoords;
+	std::vector<Vec3>			normals;
+	std::vector<uint>			indices;
+	std::vector<Meshlet>		meshlets;
+	std::vector<Material>		materials;
+	std::vector<MaterialRange>	materialRanges; // faces grouped by material, in index buffer order
+	Vec3						boundsMin;
+	Vec3						boundsMax;
+
+	Mesh();
+
+	void	clear();
+	void	computeBounds();
+	void	mergeBounds(const Mesh& other);
+	uint	triangleCount() const;
+	size_t	memoryBytes() const; // reserved capacity of the arrays
+};
+
+// Element counts of an OBJ file, used to size every array before parsing
+struct ObjCounts
+{
+	size_t	positions;
+	size_t	texcoords;
+	size_t	normals;
+	size_t	triangles;
+};
+
+ObjCounts	countObjElements(const char* filePathName);
+void		loadObjMesh(const char* filePathName, Mesh& mesh, ArenaStats* scratchStats = nullptr);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <vector>
+#include "struct.hpp"
+#include "Material.hpp"
+
+#define MESHLET_MAX_VERTICES	64
+#define MESHLET_MAX_TRIANGLES	124
+#define MESHLET_CULL_GRAIN		4096 // meshlets per culling job, smaller meshes are culled inline
+
+// A cluster of consecutive triangles of the index buffer with its culling bounds
+struct Meshlet
+{
+	uint	firstIndex;		// offset in the index buffer
+	uint	indexCount;		// 3 * triangle count
+	uint	vertexCount;	// unique vertices referenced by the cluster
+	Vec3	center;			// bounding sphere
+	float	radius;
+	Vec3	coneAxis;		// average facing direction of the triangles
+	float	coneCutoff;		// sin of the cone half angle, 1 when the cone is degenerate
+	uint	material;		// meshlets never span two materials
+};
+
+// Layout mandated by glDrawElementsIndirect / glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+	uint	count;
+	uint	instanceCount;
+	uint	firstIndex;
+	uint	baseVertex;
+	uint	baseInstance;
+};
+
+struct Frustum
+{
+	float	planes[6][4]; // a, b, c, d with (a, b, c) pointing inside
+
+	static Frustum	fromMatrix(const Mat4& viewProjection);
+	bool			intersectsSphere(const Vec3& center, float radius) const;
+};
+
+struct MeshletCullStats
+{
+	uint	submittedTriangles;
+	uint	renderedTriangles;
+	uint	visibleMeshlets;
+	uint	frustumCulled;
+	uint	backfaceCulled;
+	uint	occlusionCulled; // GPU path only
+};
+
+void	buildMeshlets(const std::vector<Vec3>& positions, const std::vector<uint>& indices, const std::vector<MaterialRange>& ranges,
+			std::vector<Meshlet>& meshlets);
+void	cullMeshlets(const std::vector<Meshlet>& meshlets, const Mat4& model, const Mat4& viewProjection, const Vec3& cameraPos,
+			bool frustumCulling, bool backfaceCulling, std::vector<DrawElementsIndirectCommand>& commands, MeshletCullStats& stats);
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "struct.hpp"
+#include "Mesh.hpp"
+#include "Arena.hpp"
+#include "MemoryStats.hpp"
+
+#define OBJ_STREAM_WINDOW_TRIANGLES	65536
+#define OBJ_NO_INDEX				0xFFFFFFFFu
+
+// A vertex of the output mesh: indices into the v/vt/vn pools, with the generated
+// uv / flat normal when the face does not reference one
+struct ObjVertexKey
+{
+	uint			position;
+	uint			texcoord;
+	uint			normal;
+	TextureCoord	uv;
+	Vec3			flatNormal;
+
+	bool operator==(const ObjVertexKey& other) const {
+		return std::memcmp(this, &other, sizeof(ObjVertexKey)) == 0;
+	}
+};
+
+struct ObjVertexKeyHash
+{
+	size_t operator()(const ObjVertexKey& key) const;
+};
+
+typedef std::pmr::unordered_map<ObjVertexKey, uint, ObjVertexKeyHash>	ObjVertexMap;
+
+// Parses an OBJ file in windows of faces. Every window is deduplicated on its own and
+// returned as an independent mesh, so the host only holds the v/vt/vn pools plus one window.
+// Faces of any size are triangulated (fan when convex, ear clipping otherwise) and
+// grouped by material inside each window.
+// The pools, the line buffer and the triangulation scratch come from the given resource; the dedup table lives in
+// an arena owned by the stream and released in one shot before each window. Both count as parser scratch memory.
+class ObjStream
+{
+	public:
+		ObjStream(const char* filePathName, std::pmr::memory_resource* resource = trackedResource(MEMORY_PARSER_SCRATCH));
+
+		bool				done() const;
+		float				progress() const;
+		void				reserve(const ObjCounts& counts, size_t vertices);
+		uint				readWindow(Mesh& window, uint maxTriangles);
+		const std::vector<Material>&	getMaterials() const;
+		const ArenaStats&	getWindowStats() const;
+
+	private:
+		std::ifstream					file;
+		std::pmr::string				line;
+		size_t							fileSize;
+		size_t							bytesRead;
+		bool							finished;
+		uint							triangleCount;
+		size_t							expectedVertices;
+		std::string						directory; // mtllib paths are relative to the OBJ file
+
+		// materials[0] is the default, usemtl switches currentMaterial
+		std::vector<Material>			materials;
+		uint							currentMaterial;
+
+		// attribute pools, faces may reference any element read so far
+		std::pmr::vector<Vec3>			positions;
+		std::pmr::vector<TextureCoord>	texcoords;
+		std::pmr::vector<Vec3>			normals;
+
+		// per-face triangulation scratch, kept across faces so large polygons allocate once
+		std::pmr::vector<uint>			faceCorners; // { position, texcoord, normal } per corner
+		std::pmr::vector<uint>			polygon; // corners not clipped yet
+		std::pmr::vector<float>			projected; // 2D corner positions for ear clipping
+
+		Arena							windowArena;
+		std::optional<ObjVertexMap>		vertexToIndex; // rebuilt for every window
+
+		uint	parseFace(const char* cursor, Mesh& window);
+		void	emitTriangle(const uint corners[3][3], Mesh& window);
+		uint	emitVertex(const ObjVertexKey& key, Mesh& window);
+		void	emitCorners(uint a, uint b, uint c, Mesh& window);
+		Vec3	faceNormal(uint cornerCount) const;
+		bool	isConvex(uint cornerCount, const Vec3& normal) const;
+		uint	clipEars(uint cornerCount, const Vec3& normal, Mesh& window);
+		void	parseMaterialLine(const char* cursor);
+		void	groupByMaterial(Mesh& window);
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "struct.hpp"
+
+#define RENDER_SCALE_MIN	0.5f
+#define RENDER_SCALE_MAX	2.0f
+#define RENDER_MAX_SAMPLES	8
+
+// Offscreen scene target, renderScale times the window size.
+// With MSAA the scene goes to multisampled renderbuffers that are resolved into single sampled
+// textures of the same size, without it straight to the textures. The resolved color is stretched
+// onto the window with linear filtering, the resolved depth feeds the occlusion culling pyramid.
+class RenderTarget
+{
+	public:
+		explicit RenderTarget(bool srgb); // srgb: the color is stored encoded, like the window's
+		~RenderTarget();
+		RenderTarget(const RenderTarget&) = delete;
+		RenderTarget&	operator=(const RenderTarget&) = delete;
+
+		void	bind(int windowWidth, int windowHeight, float scale, int samples); // reallocates on change, sets the viewport
+		void	resolve(); // leaves the resolved framebuffer bound for reading
+		void	present(int windowWidth, int windowHeight); // back to the default framebuffer
+
+		int		getWidth() const;
+		int		getHeight() const;
+		int		getSamples() const;
+		int		getMaxSamples() const;
+
+	private:
+		bool	srgb;
+		int		maxSize;
+		int		maxSamples;
+		int		width;
+		int		height;
+		int		samples;
+
+		uint	multisampleFramebuffer; // 0 without MSAA
+		uint	colorRenderbuffer;
+		uint	depthRenderbuffer;
+		uint	framebuffer;
+		uint	colorTexture;
+		uint	depthTexture;
+
+		void	create();
+		void	destroy();
+};
@@ -4,14 +4,36 @@
 #include <GLFW/glfw3.h>
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <exception>
+#include <thread>
 #include "struct.hpp"
+#include "Mesh.hpp"
+#include "GpuCulling.hpp"
+#include "StreamBuffer.hpp"
+#include "ObjStream.hpp"
+#include "MaterialTextures.hpp"
+#include "TextureLoader.hpp"
+#include "TextureCache.hpp"
+#include "ShaderVariants.hpp"
+#include "FileWatcher.hpp"
+#include "FramePacer.hpp"
+#include "FrameQueue.hpp"
+#include "RenderTarget.hpp"
+#include "GpuTimer.hpp"
+#include "DynamicResolution.hpp"
+#include "Trace.hpp"
+#include "MemoryStats.hpp"
 #include "../imgui/imgui.h"
 #include "../imgui/ImGuiFileDialog.h"
 #include "../imgui/imgui_impl_glfw.h"
 #include "../imgui/imgui_impl_opengl3.h"
 
-typedef unsigned int uint;
-typedef unsigned short ushort;
+#define STREAM_SECTION_SIZE	(4 * 1024 * 1024)
+#define IDLE_WAKE_INTERVAL	0.25 // seconds, idle waits still wake up to notice shader edits
+#define REDRAW_FRAMES		3 // frames drawn after an event, ImGui needs a few to settle hover and popups
+#define SIMULATION_STEP		(1.0 / 120.0) // seconds per update, motion does not depend on the frame rate
+#define MAX_SIMULATION_STEPS	8 // per frame, a longer hitch is dropped instead of replayed
 
 class Scop
 {
@@ -21,6 +43,7 @@ class Scop
 		void run();
 
 		void	processMouseScroll(double yoffset);
+		void	requestRedraw();
 
 		static void	scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 
@@ -30,12 +53,26 @@ class Scop
 		int			windowWidth;
 		int			windowHeight;
 
-		float		deltaTime;
-		float		lastFrame;
-		float		totalTime;
+		double		deltaTime;
+		double		lastFrame;
+		double		totalTime;
 		float		updateInterval;
 		int			frames;
 
+		// on demand rendering, frames are only drawn when something can change on screen
+		bool		renderOnDemand;
+		int			redrawFrames; // left to draw after the last event
+		int			frameCap; // frames per second, 0 for none
+		FramePacer	framePacer;
+		bool		vsync;
+		bool		appliedVsync; // render thread
+
+		// the main thread polls events and builds frames, the render thread owns the GL context
+		FrameQueue					frameQueue;
+		RenderStatus				renderStatus; // last published by the render thread
+		std::vector<RenderCommand>	pendingCommands; // GL work for the next packet
+		std::exception_ptr			renderError;
+
 		double		lastX;
 		double		lastY;
 		bool		firstMouse;
@@ -67,40 +104,110 @@ class Scop
 		float		transitionStartTime;
 		float		transitionDuration;
 
-		float		movementSpeed;
-		float		rotationSpeed;
+		// fixed timestep, frames interpolate between the last two updates
+		double		simulationAccumulator;
+		bool		lockstep; // one update per frame, frame N always shows the same state
+		float		movementSpeed; // units per second
+		float		rotationSpeed; // radians per second
 		float		rotationAngle;
+		float		previousRotationAngle;
 		Vec3		objectPosition;
+		Vec3		previousObjectPosition;
 
 		bool		showTextures;
 		bool		showWireframe;
 		bool		showLight;
 
-		uint		textureID;
+		// the scene is drawn offscreen then stretched onto the window
+		float							renderScale;
+		int								msaaSamples;
+		std::unique_ptr<RenderTarget>	renderTarget; // render thread
+
+		// dynamic resolution, the render thread lowers the scale to keep the GPU time under target
+		bool							dynamicResolution;
+		float							targetFrameMs;
+		std::unique_ptr<GpuTimer>		gpuTimer; // render thread
+		DynamicResolution				resolutionController; // render thread
+		double							gpuFrameMs; // render thread
+		float							appliedRenderScale; // render thread
+
+		bool							srgbFramebuffer; // scene colors are linear, encoded on write
+		uint							textureID; // referenced in textureCache
+		std::unique_ptr<TextureLoader>	textureLoader;
+		std::unique_ptr<TextureCache>	textureCache;
 
 		uint		vertexShader;
 		uint		fragmentShader;
-		uint		shaderProgram;
+		uint		shaderProgram; // variant drawn this frame, owned by shaderVariants
+		std::unique_ptr<ShaderVariants>	shaderVariants;
+		std::unique_ptr<FileWatcher>	shaderWatcher; // ressources/shaders, edits are rebuilt while running
+		std::vector<std::string>		changedShaders;
+		std::string						computeShaderError;
 
 		uint		VBO; // vertex buffer object
 		uint		EBO; // element buffer object
 		uint		VAO; // vertex array object
 		uint		textureVBO; // texture vertex buffer object
 		uint		normalVBO; // normal vertex buffer object
-
-		std::vector<Vec3>			vertex_postitions;
-		std::vector<TextureCoord>	vertex_texcoords;
-		std::vector<Vec3>			vertex_normals;
-		std::vector<uint>			indices;
+		uint		materialIdVBO; // 0..MATERIAL_MAX_COUNT-1, instanced so baseInstance picks the material
+
+		// geometry buffers only grow, a reload that fits reuses them
+		uint		vertexCount; // vertices and indices uploaded so far
+		uint		indexCount;
+		GLsizeiptr	VBOCapacity;
+		GLsizeiptr	EBOCapacity;
+		GLsizeiptr	textureVBOCapacity;
+		GLsizeiptr	normalVBOCapacity;
+
+		std::unique_ptr<StreamBuffer>	streamBuffer; // uniforms, draw commands and geometry uploads
+		GLint							uniformAlignment;
+
+		Mesh		mesh;
+
+		// materials, draws are batched by texture array (see MaterialTextures)
+		uint							materialUBO;
+		MaterialTextures				materialTextures;
+		std::vector<uint>				materialBatches; // material -> batch
+		std::vector<uint>				batchOffsets; // scratch of drawMeshlets
+		std::vector<DrawElementsIndirectCommand>	batchedCommands;
+
+		// progressive loading, one window of faces is parsed and uploaded per frame
+		bool						progressiveLoading;
+		std::unique_ptr<ObjStream>	objStream;
+		Mesh						streamWindow;
+
+		// meshlet culling
+		bool										frustumCulling;
+		bool										backfaceCulling;
+		std::vector<DrawElementsIndirectCommand>	drawCommands;
+		MeshletCullStats							cullStats;
+		std::unique_ptr<GpuCulling>					gpuCulling; // null when compute shaders are unavailable
+		bool										useGpuCulling;
+		bool										occlusionCulling;
 
 		void		loadShader();
+		void		reloadShaders();
+		bool		waitForFrame();
+		bool		isAnimating();
 		void		cameraMovement();
 		void		objectMovement();
+		void		advanceSimulation();
+		void		updateModelMatrix(float alpha);
 		void		updateUI();
+		void		buildFramePacket(FramePacket& packet);
+		void		renderLoop();
+		void		renderFrame(FramePacket& packet);
+		void		collectStatus(RenderStatus& status, bool gpuCulled);
 		void		createBuffersAndArrays();
+		void		appendGeometry(const Mesh& part);
 		void		loadObjFile(const char* filePathName);
+		void		streamObjFile(const char* filePathName);
+		void		streamNextWindow();
 		void		loadTexture(const char* filename);
-		void		indexVBO(std::vector<Vec3> &out_vertices, std::vector<TextureCoord> &out_uvs, std::vector<Vec3> &out_normals);
+		void		setTexture(uint texture);
+		void		updateMaterials(bool appendMeshlets = false);
+		void		drawMeshlets();
+		void		uploadFrameUniforms(const FrameUniforms& uniforms);
 		Vec3		calculateModelCenterOffset();
 		float		toRadians(float degrees);
 };
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "struct.hpp"
+
+#define SHADER_CACHE_DIRECTORY	"./.cache/shaders"
+
+struct ShaderStage
+{
+	GLenum		type;
+	std::string	source;
+};
+
+// A program between beginProgram and finishProgram
+struct PendingProgram
+{
+	uint				program;
+	std::vector<uint>	shaders; // empty when the program came from the binary cache
+	uint64_t			hash;
+	bool				cacheable;
+	std::string			name;
+	std::string			log; // compile / link errors, filled by finishProgram
+};
+
+// Link the stages into a program, returns 0 on failure.
+// Linked binaries are kept in SHADER_CACHE_DIRECTORY, keyed by a hash of the sources and of the
+// driver vendor / renderer / version strings; a binary the driver rejects is rebuilt from source.
+uint	buildProgram(const std::vector<ShaderStage>& stages, const char* name);
+
+// Same in two steps. With KHR / ARB_parallel_shader_compile the driver compiles in the background
+// and isProgramReady turns true once finishProgram will not block; without it, it is always true.
+void	enableParallelShaderCompile();
+void	beginProgram(const std::vector<ShaderStage>& stages, const char* name, PendingProgram& pending);
+bool	isProgramReady(const PendingProgram& pending);
+uint	finishProgram(PendingProgram& pending);
+
+std::string	loadShaderSource(const char* filename);
+// Inserts the lines right after #version, which must stay first
+std::string	injectDefines(const std::string& source, const std::vector<std::string>& defines);
+
+// Compile and link a program made of a single compute shader, returns 0 on failure
+uint	loadComputeProgram(const char* filename, std::string* log = nullptr);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string>
+#include "struct.hpp"
+#include "Shader.hpp"
+
+enum ShaderFeature
+{
+	SHADER_GRADIENT = 1 << 0,
+	SHADER_LIGHTING = 1 << 1,
+	SHADER_TEXTURE = 1 << 2, // the gradient replaces the texture, SHADER_GRADIENT wins
+};
+
+#define SHADER_FEATURE_MASK		7 // variants are indexed by their feature bits
+#define SHADER_VARIANT_COUNT	6 // the combinations with both GRADIENT and TEXTURE are never built
+
+// The scene program specialized for every feature combination in use: the fragment shader gets each
+// feature as a constant instead of branching on a uniform, and skips the texture fetch when unused.
+// A variant is compiled the first time it is asked for, without blocking when the driver compiles
+// in parallel; until then get() returns the generic program that branches on the uniforms.
+// reload() rebuilds from the files in the background, the current programs stay in use until the
+// new generic one links, a failed build only leaves its log in getError().
+class ShaderVariants
+{
+	public:
+		ShaderVariants(const char* vertexPath, const char* fragmentPath);
+		~ShaderVariants();
+
+		uint				get(uint features);
+		void				update();
+		void				reload();
+		bool				isReloading() const;
+		bool				isCompiling() const;
+		uint				getReadyCount() const;
+		const std::string&	getError() const;
+
+	private:
+		struct Variant
+		{
+			uint			program;
+			bool			compiling;
+			bool			failed;
+			PendingProgram	pending;
+		};
+
+		std::string	vertexPath;
+		std::string	fragmentPath;
+		std::string	vertexSource;
+		std::string	fragmentSource;
+		uint		generic;
+		Variant		variants[SHADER_FEATURE_MASK + 1];
+
+		// hot reload, the sources are only adopted once the generic program links
+		bool			reloading;
+		PendingProgram	reloadPending;
+		std::string		reloadVertexSource;
+		std::string		reloadFragmentSource;
+		std::string		error;
+
+		void	begin(uint features);
+		void	finish(Variant& variant);
+		void	finishReload();
+		void	clearVariants();
+};
+
+void	setupSceneProgram(uint program);
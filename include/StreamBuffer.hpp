@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "struct.hpp"
+
+#define STREAM_BUFFER_SECTIONS	3
+
+// Ring of STREAM_BUFFER_SECTIONS sections in one persistently mapped buffer.
+// The CPU writes the current section while the GPU reads the previous ones; a fence
+// per section makes the CPU wait only when it wraps around onto a section still in use,
+// so uploads never go through the implicit synchronization of glBufferData.
+class StreamBuffer
+{
+	public:
+		StreamBuffer(GLsizeiptr sectionSize);
+		~StreamBuffer();
+
+		void		beginFrame();
+		GLintptr	upload(const void* data, GLsizeiptr size, GLsizeiptr alignment);
+		void		copyToBuffer(uint dstBuffer, GLintptr dstOffset, const void* data, GLsizeiptr size);
+
+		uint		getBuffer() const;
+		bool		isPersistent() const;
+		uint		getStallCount() const;
+
+	private:
+		uint			buffer;
+		unsigned char*	mapped; // null when GL_ARB_buffer_storage is missing
+		GLsizeiptr		sectionSize;
+		int				section;
+		GLsizeiptr		head;
+		GLsync			fences[STREAM_BUFFER_SECTIONS];
+		uint			stallCount;
+
+		void		nextSection();
+};
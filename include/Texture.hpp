@@ -0,0 +1,21 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "struct.hpp"
+
+// Storage and upload format of a decoded image
+struct TextureFormat
+{
+	GLenum	internalFormat;
+	GLenum	format;
+	int		channels; // of the uploaded pixels, images are decoded to this count
+};
+
+// Color images are stored as sRGB when srgb is set. 1 and 2 channel images are grey (+ alpha),
+// the swizzle expands them to RGB(A). With srgb, grey is uploaded from its red channel into
+// sRGB storage and grey + alpha is decoded to RGBA, sRGB only applies to color channels.
+TextureFormat	textureFormatFor(int channels, bool srgb);
+void			applyTextureSwizzle(GLenum target, const TextureFormat& format);
+void			setUnpackAlignment(GLsizeiptr rowSize);
+int				mipLevelCount(int width, int height);
+bool			isFramebufferSrgb();
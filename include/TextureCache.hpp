@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "struct.hpp"
+
+#define TEXTURE_CACHE_BUDGET	(256 * 1024 * 1024) // default VRAM budget in bytes
+
+struct TextureCacheStats
+{
+	uint	hits;
+	uint	misses;
+	uint	evictions;
+	size_t	bytes; // VRAM held by cached textures, referenced or not
+	size_t	entries;
+};
+
+// Uploaded textures keyed by canonical path; an entry is valid while the file's mtime is unchanged.
+// Referenced textures are never evicted, unreferenced ones stay cached and are deleted in LRU
+// order once the budget is exceeded.
+class TextureCache
+{
+	public:
+		TextureCache(size_t budget = TEXTURE_CACHE_BUDGET);
+		~TextureCache();
+
+		TextureCache(const TextureCache&) = delete;
+		TextureCache& operator=(const TextureCache&) = delete;
+
+		static std::string	canonicalPath(const char* filePathName);
+
+		uint	acquire(const std::string& path);
+		void	insert(const std::string& path, uint texture, size_t bytes);
+		void	release(uint texture);
+		void	setBudget(size_t budget);
+		size_t	getBudget() const;
+
+		const TextureCacheStats&	getStats() const;
+
+	private:
+		struct Entry
+		{
+			uint							texture;
+			size_t							bytes;
+			uint							references;
+			unsigned long long				lastUse;
+			std::filesystem::file_time_type	mtime;
+		};
+
+		std::unordered_map<std::string, Entry>	entries;
+		std::vector<Entry>						stale; // replaced on disk but still referenced
+		size_t									budget;
+		unsigned long long						useCounter;
+		TextureCacheStats						stats;
+
+		void	evict();
+		void	destroy(const Entry& entry);
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "CompressedTexture.hpp"
+#include <vector>
+
+// Offline mode, started with `./scop --compress input.(bmp|png|...) output.dds [bc1|bc7]`
+// Encodes the image and its box filtered mip chain on every core and writes a DDS file.
+int		runTextureCompressor(int argc, char** argv);
+
+// Appends the blocks of an RGBA8 image and of its mip chain to output, returns the level count
+uint	compressMipChain(const unsigned char* rgba, int width, int height, BlockFormat format, std::vector<unsigned char>& output);
+
+// One 4x4 block of RGBA8 pixels, row major
+void	encodeBc1Block(const unsigned char pixels[64], unsigned char block[8]);
+void	encodeBc7Block(const unsigned char pixels[64], unsigned char block[16]); // mode 6 only
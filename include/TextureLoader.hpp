@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "struct.hpp"
+#include "Texture.hpp"
+#include "CompressedTexture.hpp"
+#include "Bmp.hpp"
+
+#define TEXTURE_UPLOAD_CHUNK	(4 * 1024 * 1024) // bytes copied into the PBO per frame
+
+struct LoadedTexture
+{
+	uint		texture;
+	std::string	path; // as requested
+	size_t		bytes; // VRAM estimate, mip chain included
+};
+
+// Loads a texture without stalling the frame: the image is decoded on the loader's thread in its
+// own channel count (DDS / KTX2 files are read as is, mip chain included, BMP files are mapped
+// and their rows copied straight into the PBO),
+// then streamed into immutable storage through a pixel buffer object a few rows per frame.
+// The caller keeps drawing with its previous texture until update() hands out the new one.
+class TextureLoader
+{
+	public:
+		TextureLoader(bool srgb);
+		~TextureLoader();
+		TextureLoader(const TextureLoader&) = delete;
+		TextureLoader&	operator=(const TextureLoader&) = delete;
+
+		void	request(const char* filename);
+		void	cancel(); // drops the request, whether it waits, decodes or uploads
+		bool	update(LoadedTexture& loaded);
+		bool	busy() const;
+		float	progress() const;
+
+	private:
+		// Shared with the worker, whoever drops it last frees the pixels
+		struct Job
+		{
+			std::string			path;
+			unsigned char*		data;
+			int					width;
+			int					height;
+			int					channels;
+			CompressedImage		compressed; // used when the file is a DDS / KTX2 container
+			bool				isCompressed;
+			BmpImage			bmp; // used when the file is a BMP GL can read as is
+			bool				isBmp;
+			std::atomic<bool>	ready;
+
+			Job(const char* filename);
+			~Job();
+
+			size_t					rowStride() const;
+			const unsigned char*	row(int y) const; // GL order, y = 0 is the bottom row
+		};
+
+		bool					srgb;
+		std::shared_ptr<Job>	job;
+
+		// One decode thread for the loader's lifetime, a request waiting for it is replaced by a newer one
+		std::thread				worker;
+		std::mutex				mutex;
+		std::condition_variable	wake;
+		std::shared_ptr<Job>	pending;
+		bool					stopping;
+
+		TextureFormat			format;
+		uint					texture; // being uploaded
+		uint					pixelBuffer;
+		int						uploadedRows;
+		uint					uploadedLevels; // compressed images are uploaded a level at a time
+
+		void	decodeLoop();
+		void	beginUpload();
+		bool	uploadRows();
+		bool	uploadLevels();
+		void	cancelUpload();
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#define TRACE_BUFFER_EVENTS	16384 // per thread, the oldest events are overwritten
+#define TRACE_DEFAULT_PATH	"./scop-trace.json"
+
+#define TRACE_CONCAT_(a, b)	a##b
+#define TRACE_CONCAT(a, b)	TRACE_CONCAT_(a, b)
+// Records the enclosing scope, name must be a string literal
+#define TRACE_SCOPE(name)	TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+
+// Engine instrumentation in the Chrome trace format (chrome://tracing, ui.perfetto.dev).
+// Every thread appends to its own ring buffer, recording takes no lock: the writer publishes an
+// event by bumping the buffer's atomic count, writeTrace() copies the buffers while they are
+// written and drops any event that was overwritten during the copy.
+void	traceEvent(const char* name, uint64_t start, uint64_t end);
+void	traceThreadName(const char* name); // shown instead of the thread id
+void	setTraceEnabled(bool enabled);
+bool	writeTrace(const std::string& path);
+
+extern std::atomic<bool>	traceEnabled;
+
+uint64_t	traceNow(); // nanoseconds, steady clock
+
+class TraceScope
+{
+	public:
+		explicit TraceScope(const char* name) : name(name), start(traceEnabled.load(std::memory_order_relaxed) ? traceNow() : 0) {}
+		~TraceScope()
+		{
+			if (this->start)
+				traceEvent(this->name, this->start, traceNow());
+		}
+		TraceScope(const TraceScope&) = delete;
+		TraceScope&	operator=(const TraceScope&) = delete;
+
+	private:
+		const char*	name;
+		uint64_t	start;
+};
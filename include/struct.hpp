@@ -5,6 +5,9 @@
 #include <cmath>
 #include <cstring>
 
+typedef unsigned int uint;
+typedef unsigned short ushort;
+
 struct Vec3 {
 	float x, y, z;
 
@@ -239,6 +242,32 @@ struct Mat4 {
 		return result;
 	}
 
+	// Apply the matrix to a point (w = 1), matching the column-major layout used by GLSL
+	Vec3 transformPoint(const Vec3& p) const {
+		return Vec3(
+			data[0] * p.x + data[4] * p.y + data[8] * p.z + data[12],
+			data[1] * p.x + data[5] * p.y + data[9] * p.z + data[13],
+			data[2] * p.x + data[6] * p.y + data[10] * p.z + data[14]
+		);
+	}
+
+	// Apply the matrix to a direction (w = 0)
+	Vec3 transformVector(const Vec3& v) const {
+		return Vec3(
+			data[0] * v.x + data[4] * v.y + data[8] * v.z,
+			data[1] * v.x + data[5] * v.y + data[9] * v.z,
+			data[2] * v.x + data[6] * v.y + data[10] * v.z
+		);
+	}
+
+	// Largest scale factor of the upper 3x3, used to grow bounding spheres
+	float maxScale() const {
+		float sx = data[0] * data[0] + data[1] * data[1] + data[2] * data[2];
+		float sy = data[4] * data[4] + data[5] * data[5] + data[6] * data[6];
+		float sz = data[8] * data[8] + data[9] * data[9] + data[10] * data[10];
+		return std::sqrt(std::max(sx, std::max(sy, sz)));
+	}
+
 	static const float* value_ptr(const Mat4& matrix) {
 		return matrix.data;
 	}
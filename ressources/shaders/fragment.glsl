@@ -3,33 +3,69 @@
 in vec2 TexCoord;
 in vec3 FragPos;
 in vec3 Normal;
+flat in uint MaterialId;
 
 out vec4 FragColor;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform vec3 lightColor;
-uniform vec3 objectColor;
+layout(std140, binding = 0) uniform FrameUniforms {
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+	vec3 lightPos;
+	float transitionFactor; // Transition factor between texture and gradient
+	vec3 lightColor;
+	bool showLight; // Show light
+	vec3 objectColor;
+	bool showGradient; // Show gradient instead of texture
+	vec3 viewPos;
+	vec3 gradientStartColor; // Gradient start color
+	vec3 gradientEndColor; // Gradient end color
+};
+
+struct Material {
+	vec3 diffuse;
+	float shininess;
+	vec3 specular;
+	int layer; // -1 samples textureSampler
+};
+
+// Material 0 is the default one, its diffuse color is objectColor
+layout(std140, binding = 1) uniform Materials {
+	Material materials[256];
+};
 
 uniform sampler2D textureSampler; // Texture sampler
-uniform bool showLight; // Show light
-uniform float transitionFactor; // Transition factor between texture and gradient
-uniform bool showGradient; // Show gradient instead of texture
-uniform vec3 gradientStartColor; // Gradient start color
-uniform vec3 gradientEndColor; // Gradient end color
+uniform sampler2DArray materialTextures; // map_Kd textures of the current batch
+
+// Specialized variants get these as true / false constants (see ShaderVariants),
+// the defaults branch on the uniforms and are drawn while a variant compiles
+#ifndef GRADIENT_ENABLED
+#define GRADIENT_ENABLED showGradient
+#endif
+#ifndef LIGHTING_ENABLED
+#define LIGHTING_ENABLED showLight
+#endif
+#ifndef TEXTURE_ENABLED
+#define TEXTURE_ENABLED (transitionFactor > 0.0)
+#endif
 
 void main() {
 	vec3 result = vec3(0.0);
+	Material material = materials[MaterialId];
+	vec3 baseColor = MaterialId == 0u ? objectColor : material.diffuse;
 
-	if (showGradient) {
+	if (GRADIENT_ENABLED) {
 		float gradientFactor = (FragPos.y + 1.0) / 2.0;
 		result = mix(gradientStartColor, gradientEndColor, gradientFactor);
+	} else if (TEXTURE_ENABLED) {
+		vec3 textureColor = material.layer < 0 ? texture(textureSampler, TexCoord).rgb
+			: texture(materialTextures, vec3(TexCoord, float(material.layer))).rgb;
+		result = mix(baseColor, textureColor, transitionFactor);
 	} else {
-		vec3 textureColor = texture(textureSampler, TexCoord).rgb;
-		result = mix(objectColor, textureColor, transitionFactor);
+		result = baseColor;
 	}
 
-	if (showLight) {
+	if (LIGHTING_ENABLED) {
 		// Calculate lighting
 		vec3 norm = normalize(Normal);
 		vec3 lightDir = normalize(lightPos - FragPos);
@@ -40,12 +76,12 @@ void main() {
 		// Specular shading
 		vec3 viewDir = normalize(viewPos - FragPos);
 		vec3 reflectDir = reflect(-lightDir, norm);
-		float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
+		float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
 
 		// Combine results
-		vec3 ambient = 0.1 * objectColor;
+		vec3 ambient = 0.1 * baseColor;
 		vec3 diffuse = diff * lightColor;
-		vec3 specular = spec * lightColor;
+		vec3 specular = spec * lightColor * material.specular;
 		result = (ambient + diffuse + specular) * result;
 	}
 
@@ -3,18 +3,32 @@
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec2 inTexCoord;
 layout(location = 2) in vec3 inNormal;
+layout(location = 3) in uint inMaterial; // per instance, selected by the draw's baseInstance
 
 out vec2 TexCoord;
 out vec3 FragPos;
 out vec3 Normal;
+flat out uint MaterialId;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140, binding = 0) uniform FrameUniforms {
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+	vec3 lightPos;
+	float transitionFactor;
+	vec3 lightColor;
+	bool showLight;
+	vec3 objectColor;
+	bool showGradient;
+	vec3 viewPos;
+	vec3 gradientStartColor;
+	vec3 gradientEndColor;
+};
 
 void main() {
 	gl_Position = projection * view * model * vec4(inPosition, 1.0);
 	TexCoord = inTexCoord;
 	FragPos = vec3(model * vec4(inPosition, 1.0));
 	Normal = mat3(transpose(inverse(model))) * inNormal;
+	MaterialId = inMaterial;
 }
@@ -1,4 +1,7 @@
 #include "../include/Scop.hpp"
+#include "../imgui/stb_image.h"
+#include <cmath>
+#include <cstdlib>
 #include <stdexcept>
 
 void	errorCallback(int error, const char* description)
@@ -11,6 +14,25 @@ void	Scop::scrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 {
 	Scop* scop = static_cast<Scop*>(glfwGetWindowUserPointer(window));
 	scop->processMouseScroll(yoffset);
+	scop->requestRedraw();
+}
+
+static void	wakeCallback(GLFWwindow* window)
+{
+	static_cast<Scop*>(glfwGetWindowUserPointer(window))->requestRedraw();
+}
+
+// Installed before ImGui, which chains to them, so any input wakes an idle loop
+static void	installWakeCallbacks(GLFWwindow* window)
+{
+	glfwSetCursorPosCallback(window, [](GLFWwindow* w, double, double) { wakeCallback(w); });
+	glfwSetMouseButtonCallback(window, [](GLFWwindow* w, int, int, int) { wakeCallback(w); });
+	glfwSetKeyCallback(window, [](GLFWwindow* w, int, int, int, int) { wakeCallback(w); });
+	glfwSetCharCallback(window, [](GLFWwindow* w, unsigned int) { wakeCallback(w); });
+	glfwSetCursorEnterCallback(window, [](GLFWwindow* w, int) { wakeCallback(w); });
+	glfwSetWindowFocusCallback(window, [](GLFWwindow* w, int) { wakeCallback(w); });
+	glfwSetFramebufferSizeCallback(window, [](GLFWwindow* w, int, int) { wakeCallback(w); });
+	glfwSetWindowRefreshCallback(window, wakeCallback);
 }
 
 Scop::Scop()
@@ -28,6 +50,7 @@ Scop::Scop()
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE);
 
 	// Create window
 	this->windowWidth = 1920;
@@ -47,22 +70,33 @@ Scop::Scop()
 		throw std::runtime_error("Error while initializing GLAD");
 	}
 
-	// Initialize ImGui
+	glfwSetWindowUserPointer(this->window, this);
+	installWakeCallbacks(this->window);
+	this->renderOnDemand = true;
+	this->redrawFrames = REDRAW_FRAMES;
+	this->frameCap = 0;
+	this->vsync = true;
+	this->appliedVsync = true;
+	glfwSwapInterval(1);
+
+	// Initialize ImGui, its allocations are counted as UI memory
+	ImGui::SetAllocatorFunctions([](size_t size, void*) { return trackedMalloc(MEMORY_UI, size); }, [](void* pointer, void*) { trackedFree(pointer); });
 	ImGui::CreateContext();
 	ImGui_ImplGlfw_InitForOpenGL(this->window, true);
 	ImGui_ImplOpenGL3_Init();
+	// Builds the font atlas now, ImGui::NewFrame runs on the main thread without the GL context
+	ImGui_ImplOpenGL3_NewFrame();
 
 	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS);
 	//glEnable(GL_CULL_FACE);
 
-	this->deltaTime = 0.0f;
-	this->lastFrame = 0.0f;
-	this->totalTime = 0.0f;
+	this->deltaTime = 0.0;
+	this->lastFrame = glfwGetTime();
+	this->totalTime = 0.0;
 	this->updateInterval = 0.1f;
 	this->frames = 0;
 
-	glfwSetWindowUserPointer(this->window, this);
 	glfwSetScrollCallback(this->window, scrollCallback);
 	glfwSetInputMode(this->window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 	this->lastX = this->windowWidth / 2.0f;
@@ -76,6 +110,12 @@ Scop::Scop()
 	this->showTextures = false;
 	this->showWireframe = false;
 	this->showLight = false;
+	this->renderScale = 1.0f;
+	this->msaaSamples = 1;
+	this->dynamicResolution = false;
+	this->targetFrameMs = DYNAMIC_RESOLUTION_TARGET_MS;
+	this->gpuFrameMs = 0.0;
+	this->appliedRenderScale = 1.0f;
 
 	this->cameraPos = Vec3(0.0f, 0.0f, 3.0f);
 	this->cameraFront = Vec3(0.0f, 0.0f, -1.0f);
@@ -90,10 +130,14 @@ Scop::Scop()
 	this->lightPos = Vec3(3.0f, 10.0f, 5.0f);
 	this->objectColor = Vec3(1.0f, 0.5f, 0.31f);
 
-	this->movementSpeed = 0.05f;
+	this->simulationAccumulator = 0.0;
+	this->lockstep = false;
+	this->movementSpeed = 3.0f;
 	this->rotationSpeed = 0.5f;
 	this->rotationAngle = 0.0f;
+	this->previousRotationAngle = 0.0f;
 	this->objectPosition = Vec3(0.0f, 0.0f, 0.0f);
+	this->previousObjectPosition = this->objectPosition;
 
 	this->transition = false;
 	this->previousShowTextures = false;
@@ -101,6 +145,62 @@ Scop::Scop()
 	this->transitionStartTime = 0.0f;
 	this->transitionDuration = 1.0f;
 
+	this->frustumCulling = true;
+	this->backfaceCulling = true;
+	this->cullStats = {};
+
+	this->VAO = 0;
+	this->VBO = 0;
+	this->EBO = 0;
+	this->textureVBO = 0;
+	this->normalVBO = 0;
+	this->textureID = 0;
+
+	std::vector<uint> materialIds(MATERIAL_MAX_COUNT);
+	for (uint i = 0; i < MATERIAL_MAX_COUNT; i++)
+		materialIds[i] = i;
+	glGenBuffers(1, &this->materialIdVBO);
+	glBindBuffer(GL_ARRAY_BUFFER, this->materialIdVBO);
+	glBufferData(GL_ARRAY_BUFFER, materialIds.size() * sizeof(uint), materialIds.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glGenBuffers(1, &this->materialUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, this->materialUBO);
+	glBufferData(GL_UNIFORM_BUFFER, MATERIAL_MAX_COUNT * sizeof(GpuMaterial), nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	trackGpuResource(GPU_BUFFER, this->materialIdVBO, "materials", materialIds.size() * sizeof(uint));
+	trackGpuResource(GPU_BUFFER, this->materialUBO, "materials", MATERIAL_MAX_COUNT * sizeof(GpuMaterial));
+	this->vertexCount = 0;
+	this->indexCount = 0;
+	this->progressiveLoading = false;
+	this->VBOCapacity = 0;
+	this->EBOCapacity = 0;
+	this->textureVBOCapacity = 0;
+	this->normalVBOCapacity = 0;
+
+	this->srgbFramebuffer = isFramebufferSrgb();
+	// Every decoder hands out rows bottom-up like GL expects, so mapped BMPs upload without a copy
+	stbi_set_flip_vertically_on_load(1);
+	this->textureLoader = std::make_unique<TextureLoader>(this->srgbFramebuffer);
+	this->textureCache = std::make_unique<TextureCache>();
+	this->materialTextures.setSrgb(this->srgbFramebuffer);
+	this->streamBuffer = std::make_unique<StreamBuffer>(STREAM_SECTION_SIZE);
+	this->renderTarget = std::make_unique<RenderTarget>(this->srgbFramebuffer);
+	this->gpuTimer = std::make_unique<GpuTimer>();
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &this->uniformAlignment);
+
+	this->useGpuCulling = false;
+	this->occlusionCulling = true;
+	if (GpuCulling::isSupported())
+	{
+		try {
+			this->gpuCulling = std::make_unique<GpuCulling>();
+			this->useGpuCulling = true;
+		} catch (std::exception& e) {
+			std::cerr << e.what() << ", falling back to CPU culling" << std::endl;
+		}
+	}
+
 	this->showGradient = true;
 	this->gradientStartColor = Vec3(0.0f, 0.0f, 0.0f);
 	this->gradientEndColor = Vec3(1.0f, 1.0f, 1.0f);
@@ -113,14 +213,25 @@ Scop::Scop()
 
 Scop::~Scop()
 {
-	glDeleteProgram(shaderProgram);
+	this->shaderVariants.reset();
+	this->shaderWatcher.reset();
 
 	glDeleteVertexArrays(1, &VAO);
 	glDeleteBuffers(1, &VBO);
 	glDeleteBuffers(1, &EBO);
 	glDeleteBuffers(1, &textureVBO);
 	glDeleteBuffers(1, &normalVBO);
-	glDeleteTextures(1, &textureID);
+	glDeleteBuffers(1, &materialIdVBO);
+	glDeleteBuffers(1, &materialUBO);
+	for (uint buffer : { VBO, EBO, textureVBO, normalVBO, materialIdVBO, materialUBO })
+		untrackGpuResource(GPU_BUFFER, buffer);
+	this->materialTextures.clear();
+	this->gpuCulling.reset();
+	this->renderTarget.reset();
+	this->gpuTimer.reset();
+	this->streamBuffer.reset();
+	this->textureLoader.reset();
+	this->textureCache.reset();
 
 	ImGui_ImplOpenGL3_Shutdown();
 	ImGui_ImplGlfw_Shutdown();
@@ -130,51 +241,367 @@ Scop::~Scop()
 	glfwTerminate();
 }
 
+// Piecewise sRGB curve, the exact inverse of the framebuffer's encoding
+static float	srgbToLinear(float c)
+{
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+// Colors picked in the UI are sRGB, the shader works on linear values when the framebuffer encodes
+static Vec3	toLinear(const Vec3& color, bool srgbFramebuffer)
+{
+	if (!srgbFramebuffer)
+		return color;
+	return Vec3(srgbToLinear(color.x), srgbToLinear(color.y), srgbToLinear(color.z));
+}
+
+// The main thread polls events, runs the simulation and builds the UI into a packet; the render
+// thread draws it meanwhile, so a slow UI frame never holds back GL submission
 void	Scop::run()
 {
-	while (!glfwWindowShouldClose(this->window) && glfwGetKey(this->window, GLFW_KEY_ESCAPE) != GLFW_PRESS)
+	this->collectStatus(this->renderStatus, this->useGpuCulling);
+	this->frameQueue.publishStatus(this->renderStatus);
+	glfwMakeContextCurrent(nullptr);
+	std::thread renderThread(&Scop::renderLoop, this);
+	traceThreadName("main");
+
+	while (!glfwWindowShouldClose(this->window) && glfwGetKey(this->window, GLFW_KEY_ESCAPE) != GLFW_PRESS
+		&& !this->frameQueue.isStopped())
 	{
-		glfwPollEvents();
+		this->frameQueue.readStatus(this->renderStatus);
+		if (!this->waitForFrame())
+			continue;
+		TRACE_SCOPE("main frame");
 
-		float currentFrame = glfwGetTime();
+		double currentFrame = glfwGetTime();
 		this->deltaTime = currentFrame - this->lastFrame;
 		this->lastFrame = currentFrame;
 		this->totalTime += this->deltaTime;
 		this->frames++;
 
-		this->cameraMovement();
-		this->objectMovement();
-
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glUseProgram(this->shaderProgram);
-		glUniformMatrix4fv(glGetUniformLocation(this->shaderProgram, "model"), 1, GL_FALSE, Mat4::value_ptr(this->model));
-		glUniformMatrix4fv(glGetUniformLocation(this->shaderProgram, "view"), 1, GL_FALSE, Mat4::value_ptr(this->view));
-		glUniformMatrix4fv(glGetUniformLocation(this->shaderProgram, "projection"), 1, GL_FALSE, Mat4::value_ptr(this->projection));
-		glUniform3fv(glGetUniformLocation(this->shaderProgram, "lightColor"), 1, Vec3::value_ptr(this->lightColor));
-		glUniform3fv(glGetUniformLocation(this->shaderProgram, "lightPos"), 1, Vec3::value_ptr(this->lightPos));
-		glUniform3fv(glGetUniformLocation(this->shaderProgram, "objectColor"), 1, Vec3::value_ptr(this->objectColor));
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glUniform1i(glGetUniformLocation(this->shaderProgram, "textureSampler"), 0);
-		glUniform1i(glGetUniformLocation(this->shaderProgram, "showLight"), this->showLight);
-		glUniform1f(glGetUniformLocation(this->shaderProgram, "transitionFactor"), this->transitionFactor);
-		glUniform1i(glGetUniformLocation(this->shaderProgram, "showGradient"), this->showGradient);
-		glUniform3fv(glGetUniformLocation(this->shaderProgram, "gradientStartColor"), 1, Vec3::value_ptr(this->gradientStartColor));
-		glUniform3fv(glGetUniformLocation(this->shaderProgram, "gradientEndColor"), 1, Vec3::value_ptr(this->gradientEndColor));
-
-		if (showWireframe)
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+		{
+			TRACE_SCOPE("simulation");
+			this->cameraTarget = this->renderStatus.modelCenterOffset;
+			this->cameraMovement();
+			this->advanceSimulation();
+		}
+		this->updateUI();
+
+		TRACE_SCOPE("submit packet");
+		FramePacket& packet = this->frameQueue.beginWrite();
+		this->buildFramePacket(packet);
+		this->frameQueue.submit();
+	}
+
+	this->frameQueue.stop();
+	renderThread.join();
+	glfwMakeContextCurrent(this->window);
+	// SCOP_TRACE=file.json keeps the trace of the whole run
+	const char* tracePath = std::getenv("SCOP_TRACE");
+	if (tracePath)
+		writeTrace(tracePath);
+	if (this->renderError)
+		std::rethrow_exception(this->renderError);
+}
+
+// Everything the render thread reads from the main thread goes through the packet
+void	Scop::buildFramePacket(FramePacket& packet)
+{
+	FrameUniforms& uniforms = packet.uniforms;
+	uniforms.model = this->model;
+	uniforms.view = this->view;
+	uniforms.projection = this->projection;
+	uniforms.lightPos = this->lightPos;
+	uniforms.transitionFactor = this->transitionFactor;
+	uniforms.lightColor = toLinear(this->lightColor, this->srgbFramebuffer);
+	uniforms.showLight = this->showLight;
+	uniforms.objectColor = toLinear(this->objectColor, this->srgbFramebuffer);
+	uniforms.showGradient = this->showGradient;
+	uniforms.viewPos = this->cameraPos;
+	uniforms.gradientStartColor = toLinear(this->gradientStartColor, this->srgbFramebuffer);
+	uniforms.gradientEndColor = toLinear(this->gradientEndColor, this->srgbFramebuffer);
+
+	packet.shaderFeatures = (this->showGradient ? SHADER_GRADIENT : 0) | (this->showLight ? SHADER_LIGHTING : 0)
+		| (this->transitionFactor > 0.0f ? SHADER_TEXTURE : 0);
+	packet.showWireframe = this->showWireframe;
+	packet.frustumCulling = this->frustumCulling;
+	packet.backfaceCulling = this->backfaceCulling;
+	packet.occlusionCulling = this->occlusionCulling;
+	packet.useGpuCulling = this->useGpuCulling;
+	packet.vsync = this->vsync;
+	glfwGetFramebufferSize(this->window, &packet.framebufferWidth, &packet.framebufferHeight);
+	packet.renderScale = this->renderScale;
+	packet.msaaSamples = this->msaaSamples;
+	packet.dynamicResolution = this->dynamicResolution;
+	packet.targetFrameMs = this->targetFrameMs;
+	// the render thread empties the vector it ran, it comes back as the next pending one
+	packet.commands.swap(this->pendingCommands);
+	packet.setDrawData(ImGui::GetDrawData());
+}
+
+// An exception stops the queue, run() rethrows it once the thread is joined
+void	Scop::renderLoop()
+{
+	RenderStatus status;
+
+	traceThreadName("render");
+	glfwMakeContextCurrent(this->window);
+	try {
+		FramePacket* packet;
+		while (this->frameQueue.acquire(packet))
+		{
+			bool gpuCulled = packet->useGpuCulling && this->gpuCulling;
+			this->renderFrame(*packet);
+			this->frameQueue.release();
+			this->collectStatus(status, gpuCulled);
+			this->frameQueue.publishStatus(status);
+		}
+	} catch (...) {
+		this->renderError = std::current_exception();
+		this->frameQueue.release();
+		this->frameQueue.stop();
+	}
+	glfwMakeContextCurrent(nullptr);
+}
+
+void	Scop::renderFrame(FramePacket& packet)
+{
+	const FrameUniforms& uniforms = packet.uniforms;
+	Mat4 viewProjection = uniforms.view * uniforms.projection;
+
+	TRACE_SCOPE("render frame");
+	this->streamBuffer->beginFrame();
+	{
+		TRACE_SCOPE("render commands");
+		for (RenderCommand& command : packet.commands)
+			command();
+		packet.commands.clear();
+	}
+	if (this->objStream)
+		this->streamNextWindow();
+	{
+		TRACE_SCOPE("texture upload");
+		LoadedTexture loaded;
+		if (this->textureLoader->update(loaded))
+		{
+			this->textureCache->insert(TextureCache::canonicalPath(loaded.path.c_str()), loaded.texture, loaded.bytes);
+			this->setTexture(loaded.texture);
+		}
+	}
+	this->shaderVariants->update();
+
+	// GPU times come in a few frames late, the scale follows the last one known
+	double gpuMs;
+	if (this->gpuTimer->poll(gpuMs))
+	{
+		this->gpuFrameMs = gpuMs;
+		if (packet.dynamicResolution)
+			this->resolutionController.update(gpuMs, packet.targetFrameMs, RENDER_SCALE_MIN, packet.renderScale);
+	}
+	this->appliedRenderScale = packet.dynamicResolution
+		? std::min(this->resolutionController.getScale(), packet.renderScale) : packet.renderScale;
+
+	this->gpuTimer->begin();
+	this->renderTarget->bind(packet.framebufferWidth, packet.framebufferHeight, this->appliedRenderScale, packet.msaaSamples);
+	glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	bool useGpuCulling = packet.useGpuCulling && this->gpuCulling;
+	{
+		TRACE_SCOPE("cull");
+		if (useGpuCulling)
+			this->gpuCulling->cull(uniforms.model, viewProjection, uniforms.viewPos,
+				packet.frustumCulling, packet.backfaceCulling, packet.occlusionCulling);
 		else
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			cullMeshlets(this->mesh.meshlets, uniforms.model, viewProjection, uniforms.viewPos,
+				packet.frustumCulling, packet.backfaceCulling, this->drawCommands, this->cullStats);
+	}
 
-		glBindVertexArray(this->VAO);
-		glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-		glUseProgram(0);
+	if (this->srgbFramebuffer)
+		glEnable(GL_FRAMEBUFFER_SRGB);
+	this->shaderProgram = this->shaderVariants->get(packet.shaderFeatures);
+	glUseProgram(this->shaderProgram);
+	this->uploadFrameUniforms(uniforms);
+	glBindBufferBase(GL_UNIFORM_BUFFER, 1, this->materialUBO);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, this->textureID);
+
+	if (packet.showWireframe)
+		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	else
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+	glBindVertexArray(this->VAO);
+	if (useGpuCulling)
+	{
+		TRACE_SCOPE("draw batches");
+		for (uint batch = 0; batch < this->materialTextures.getBatchCount(); batch++)
+		{
+			this->materialTextures.bind(batch);
+			this->gpuCulling->draw(batch);
+		}
+	}
+	else
+		this->drawMeshlets();
+	glBindVertexArray(0);
+	glUseProgram(0);
+	glDisable(GL_FRAMEBUFFER_SRGB);
+
+	// The pyramid is built from the resolved depth, at the render resolution
+	this->renderTarget->resolve();
+	if (useGpuCulling && packet.occlusionCulling)
+	{
+		TRACE_SCOPE("depth pyramid");
+		this->gpuCulling->buildDepthPyramid(this->renderTarget->getWidth(), this->renderTarget->getHeight(), uniforms.model * viewProjection);
+	}
+	this->renderTarget->present(packet.framebufferWidth, packet.framebufferHeight);
 
-		this->updateUI();
+	{
+		TRACE_SCOPE("draw UI");
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplOpenGL3_RenderDrawData(&packet.drawData);
+	}
+	this->gpuTimer->end();
+
+	if (packet.vsync != this->appliedVsync)
+	{
+		glfwSwapInterval(packet.vsync ? 1 : 0);
+		this->appliedVsync = packet.vsync;
+	}
+	TRACE_SCOPE("swap");
+	glfwSwapBuffers(this->window);
+}
+
+// What the UI shows of the state owned by the render thread
+void	Scop::collectStatus(RenderStatus& status, bool gpuCulled)
+{
+	status.cullStats = gpuCulled ? this->gpuCulling->getStats() : this->cullStats;
+	status.meshletCount = this->mesh.meshlets.size();
+	status.streamPersistent = this->streamBuffer->isPersistent();
+	status.streamStalls = this->streamBuffer->getStallCount();
+	status.streaming = this->objStream != nullptr;
+	status.streamProgress = this->objStream ? this->objStream->progress() : 1.0f;
+	status.textureLoading = this->textureLoader->busy();
+	status.textureProgress = this->textureLoader->progress();
+	status.cacheStats = this->textureCache->getStats();
+	status.cacheBudget = this->textureCache->getBudget();
+	status.shaderVariantsReady = this->shaderVariants->getReadyCount();
+	status.shadersCompiling = this->shaderVariants->isCompiling();
+	status.shadersReloading = this->shaderVariants->isReloading();
+	status.shaderError = this->shaderVariants->getError();
+	status.computeShaderError = this->computeShaderError;
+	status.modelCenterOffset = this->calculateModelCenterOffset();
+	status.renderWidth = this->renderTarget->getWidth();
+	status.renderHeight = this->renderTarget->getHeight();
+	status.renderSamples = this->renderTarget->getSamples();
+	status.maxSamples = this->renderTarget->getMaxSamples();
+	status.renderScale = this->appliedRenderScale;
+	status.gpuMs = this->gpuFrameMs;
+	status.headroomMs = this->resolutionController.getHeadroomMs();
+}
+
+void	Scop::requestRedraw()
+{
+	this->redrawFrames = REDRAW_FRAMES;
+}
+
+// Anything that changes the picture without an input event
+bool	Scop::isAnimating()
+{
+	static const int movementKeys[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_Q, GLFW_KEY_E, GLFW_KEY_SPACE };
+
+	const RenderStatus& status = this->renderStatus;
+	if (this->rotationSpeed != 0.0f || this->transition || !this->pendingCommands.empty())
+		return true;
+	if (status.streaming || status.textureLoading || status.shadersCompiling)
+		return true;
+	if (glfwGetMouseButton(this->window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
+		return true;
+	for (int key : movementKeys)
+		if (glfwGetKey(this->window, key) == GLFW_PRESS)
+			return true;
+	return false;
+}
 
-		glfwSwapBuffers(window);
+// Returns false when there is nothing new to draw. Idle, the loop sleeps in glfwWaitEventsTimeout
+// instead of spinning; otherwise events are polled and the frame is paced to frameCap.
+bool	Scop::waitForFrame()
+{
+	this->reloadShaders();
+	if (this->renderOnDemand && this->redrawFrames == 0 && !this->isAnimating())
+	{
+		glfwWaitEventsTimeout(IDLE_WAKE_INTERVAL);
+		this->reloadShaders();
+		if (this->redrawFrames == 0 && !this->isAnimating())
+			return false;
+		// the time spent asleep is not animation time
+		this->lastFrame = glfwGetTime();
 	}
+	else
+		glfwPollEvents();
+
+	this->framePacer.setRate(this->frameCap);
+	this->framePacer.wait();
+	if (this->redrawFrames > 0)
+		this->redrawFrames--;
+	return true;
+}
+
+void	Scop::uploadFrameUniforms(const FrameUniforms& uniforms)
+{
+	GLintptr offset = this->streamBuffer->upload(&uniforms, sizeof(uniforms), this->uniformAlignment);
+	glBindBufferRange(GL_UNIFORM_BUFFER, 0, this->streamBuffer->getBuffer(), offset, sizeof(uniforms));
+}
+
+// Commands are sorted by batch so every texture array is bound once and drawn with one call
+void	Scop::drawMeshlets()
+{
+	TRACE_SCOPE("drawMeshlets");
+	if (this->drawCommands.empty())
+		return;
+
+	uint batchCount = this->materialTextures.getBatchCount();
+	this->batchOffsets.assign(batchCount + 1, 0);
+	for (const DrawElementsIndirectCommand& command : this->drawCommands)
+		this->batchOffsets[this->materialBatches[command.baseInstance] + 1]++;
+	for (uint batch = 0; batch < batchCount; batch++)
+		this->batchOffsets[batch + 1] += this->batchOffsets[batch];
+
+	this->batchedCommands.resize(this->drawCommands.size());
+	for (const DrawElementsIndirectCommand& command : this->drawCommands)
+		this->batchedCommands[this->batchOffsets[this->materialBatches[command.baseInstance]]++] = command;
+	// batchOffsets[b] is now the end of batch b, i.e. the start of batch b + 1
+	for (uint batch = batchCount; batch > 0; batch--)
+		this->batchOffsets[batch] = this->batchOffsets[batch - 1];
+	this->batchOffsets[0] = 0;
+
+	GLsizeiptr size = this->batchedCommands.size() * sizeof(DrawElementsIndirectCommand);
+	GLintptr offset = this->streamBuffer->upload(this->batchedCommands.data(), size, sizeof(uint));
+	if (offset < 0)
+	{
+		// More commands than a stream section holds, draw everything with the default material
+		glDrawElements(GL_TRIANGLES, this->indexCount, GL_UNSIGNED_INT, 0);
+		return;
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->streamBuffer->getBuffer());
+	for (uint batch = 0; batch < batchCount; batch++)
+	{
+		uint first = this->batchOffsets[batch];
+		uint count = this->batchOffsets[batch + 1] - first;
+		if (count == 0)
+			continue;
+
+		this->materialTextures.bind(batch);
+		GLintptr commands = offset + first * sizeof(DrawElementsIndirectCommand);
+		if (GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_multi_draw_indirect)
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)commands, count, 0);
+		else
+		{
+			for (uint i = 0; i < count; i++)
+				glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(commands + i * sizeof(DrawElementsIndirectCommand)));
+		}
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 }
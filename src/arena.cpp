@@ -0,0 +1,87 @@
+#include "../include/Arena.hpp"
+#include <algorithm>
+#include <cstdint>
+
+Arena::Arena(size_t blockSize, std::pmr::memory_resource* upstream)
+{
+	this->upstream = upstream;
+	this->blockSize = blockSize;
+	this->blocks = nullptr;
+	this->cursor = nullptr;
+	this->end = nullptr;
+	this->stats = {};
+}
+
+Arena::~Arena()
+{
+	this->releaseBlocks(this->blocks);
+}
+
+void	Arena::releaseBlocks(Block* block)
+{
+	while (block)
+	{
+		Block* next = block->next;
+		this->upstream->deallocate(block, block->size, alignof(std::max_align_t));
+		block = next;
+	}
+}
+
+void	Arena::addBlock(size_t minSize)
+{
+	size_t size = std::max(this->blockSize, minSize + sizeof(Block) + alignof(std::max_align_t));
+	Block* block = static_cast<Block*>(this->upstream->allocate(size, alignof(std::max_align_t)));
+
+	block->next = this->blocks;
+	block->size = size;
+	this->blocks = block;
+	this->cursor = reinterpret_cast<char*>(block) + sizeof(Block);
+	this->end = reinterpret_cast<char*>(block) + size;
+	this->stats.blocks++;
+	this->stats.reserved += size;
+}
+
+// Everything handed out so far becomes invalid, the most recent block is kept for reuse
+void	Arena::reset()
+{
+	if (!this->blocks)
+		return;
+
+	this->releaseBlocks(this->blocks->next);
+	this->blocks->next = nullptr;
+	this->cursor = reinterpret_cast<char*>(this->blocks) + sizeof(Block);
+	this->end = reinterpret_cast<char*>(this->blocks) + this->blocks->size;
+}
+
+const ArenaStats&	Arena::getStats() const
+{
+	return this->stats;
+}
+
+void*	Arena::do_allocate(size_t bytes, size_t alignment)
+{
+	uintptr_t aligned = (reinterpret_cast<uintptr_t>(this->cursor) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+
+	if (!this->cursor || aligned + bytes > reinterpret_cast<uintptr_t>(this->end))
+	{
+		this->addBlock(bytes + alignment);
+		aligned = (reinterpret_cast<uintptr_t>(this->cursor) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+	}
+
+	this->cursor = reinterpret_cast<char*>(aligned + bytes);
+	this->stats.allocations++;
+	this->stats.bytes += bytes;
+	return reinterpret_cast<void*>(aligned);
+}
+
+void	Arena::do_deallocate(void* p, size_t bytes, size_t alignment)
+{
+	(void)p;
+	(void)bytes;
+	(void)alignment;
+}
+
+bool	Arena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+	return this == &other;
+}
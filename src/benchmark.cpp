@@ -0,0 +1,555 @@
+#include "../include/Benchmark.hpp"
+#include "../include/Mesh.hpp"
+#include "../include/Bmp.hpp"
+#include "../include/JobSystem.hpp"
+#include "../include/MemoryStats.hpp"
+#include "../include/TextureCompressor.hpp"
+#include "../include/Trace.hpp"
+#include "../imgui/stb_image.h"
+#include <cfloat>
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+#define BENCH_TESSELLATION_LEVELS	3
+#define BENCH_ORBIT_STEPS			8
+#define BENCH_SYNTHETIC_TRIANGLES	20000000
+#define BENCH_TEXTURE_SIZE			8192
+#define BENCH_TEXTURE_RUNS			3
+#define BENCH_SCALING_TRIANGLES		4000000 // enough meshlets for a few culling jobs per thread
+#define BENCH_SCALING_IMAGE			2048
+#define BENCH_SCALING_RUNS			3
+
+static const char*	defaultModels[] = { "./ressources/teapot.obj", "./ressources/deer.obj" };
+static const char*	defaultTextures[] = { "./ressources/brick.bmp", "./ressources/chaton.bmp" };
+
+typedef std::chrono::steady_clock	benchClock;
+
+static double	elapsedMs(benchClock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(benchClock::now() - start).count();
+}
+
+// Split every triangle in four, sharing the new edge midpoints between neighbours
+static void	tessellate(Mesh& mesh)
+{
+	std::unordered_map<uint64_t, uint> midpoints;
+	std::vector<uint> indices;
+	indices.reserve(mesh.indices.size() * 4);
+
+	auto midpoint = [&](uint a, uint b) {
+		uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+		auto it = midpoints.find(key);
+		if (it != midpoints.end())
+			return it->second;
+		uint index = static_cast<uint>(mesh.positions.size());
+		mesh.positions.push_back((mesh.positions[a] + mesh.positions[b]) * 0.5f);
+		midpoints[key] = index;
+		return index;
+	};
+
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		uint a = mesh.indices[i], b = mesh.indices[i + 1], c = mesh.indices[i + 2];
+		uint ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+		uint triangles[12] = { a, ab, ca, ab, b, bc, ca, bc, c, ab, bc, ca };
+		indices.insert(indices.end(), triangles, triangles + 12);
+	}
+	mesh.indices.swap(indices);
+	// every triangle became four consecutive ones, the material ranges scale with them
+	for (MaterialRange& range : mesh.materialRanges)
+	{
+		range.firstIndex *= 4;
+		range.indexCount *= 4;
+	}
+	mesh.texcoords.clear();
+	mesh.normals.clear();
+}
+
+static void	boundingSphere(const Mesh& mesh, Vec3& center, float& radius)
+{
+	Vec3 min = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vec3 max = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for (const Vec3& p : mesh.positions)
+	{
+		min = Vec3::min(min, p);
+		max = Vec3::max(max, p);
+	}
+	center = (min + max) * 0.5f;
+	radius = std::max(Vec3::length(max - center), 0.001f);
+}
+
+// Orbit views around the model: a ring that sees the whole mesh and a close-up ring
+// where part of it falls outside of the frustum
+static void	benchMeshletCulling(const char* file, bool& first)
+{
+	Mesh mesh;
+	loadObjMesh(file, mesh);
+
+	Vec3 center;
+	float radius;
+	boundingSphere(mesh, center, radius);
+
+	for (int level = 0; level <= BENCH_TESSELLATION_LEVELS; level++)
+	{
+		if (level > 0)
+			tessellate(mesh);
+
+		benchClock::time_point start = benchClock::now();
+		buildMeshlets(mesh.positions, mesh.indices, mesh.materialRanges, mesh.meshlets);
+		double buildMs = elapsedMs(start);
+
+		Mat4 projection = Mat4::perspective(45.0f * M_PI / 180.0f, 16.0f / 9.0f, radius * 0.01f, radius * 10.0f);
+		std::vector<DrawElementsIndirectCommand> commands;
+		MeshletCullStats stats;
+		uint64_t submitted = 0, rendered = 0, frustumCulled = 0, backfaceCulled = 0, views = 0;
+		double cullMs = 0.0;
+
+		for (float distance : { radius * 2.5f, radius * 1.1f })
+		{
+			for (int step = 0; step < BENCH_ORBIT_STEPS; step++)
+			{
+				float angle = step * 2.0f * M_PI / BENCH_ORBIT_STEPS;
+				Vec3 eye = center + Vec3(std::cos(angle), 0.3f, std::sin(angle)) * distance;
+				Mat4 view = Mat4::lookAt(eye, center, Vec3(0.0f, 1.0f, 0.0f));
+
+				start = benchClock::now();
+				cullMeshlets(mesh.meshlets, Mat4(), view * projection, eye, true, true, commands, stats);
+				cullMs += elapsedMs(start);
+
+				submitted += stats.submittedTriangles;
+				rendered += stats.renderedTriangles;
+				frustumCulled += stats.frustumCulled;
+				backfaceCulled += stats.backfaceCulled;
+				views++;
+			}
+		}
+
+		std::cout << (first ? "" : ",\n") << "\t\t{ \"file\": \"" << file << "\", \"level\": " << level
+			<< ", \"triangles\": " << mesh.triangleCount() << ", \"meshlets\": " << mesh.meshlets.size()
+			<< ", \"buildMs\": " << buildMs << ", \"views\": " << views
+			<< ", \"submittedTriangles\": " << submitted / views << ", \"renderedTriangles\": " << rendered / views
+			<< ", \"renderedRatio\": " << (submitted ? static_cast<double>(rendered) / submitted : 0.0)
+			<< ", \"frustumCulledMeshlets\": " << frustumCulled / views << ", \"backfaceCulledMeshlets\": " << backfaceCulled / views
+			<< ", \"cullMsPerView\": " << cullMs / views << " }";
+		first = false;
+	}
+}
+
+struct LoadMeasure
+{
+	bool		ok;
+	double		ms;
+	uint		triangles;
+	uint		vertices;
+	long		peakRssKb;
+	ArenaStats	scratch;
+	MemoryCategoryStats	memory[MEMORY_CATEGORY_COUNT];
+};
+
+typedef void	(*ObjLoader)(const char* filePathName, Mesh& mesh, ArenaStats* scratchStats);
+
+// Peak RSS is per process, every load runs in its own child so the numbers do not mix
+static LoadMeasure	measureLoad(const char* file, ObjLoader loader)
+{
+	LoadMeasure measure = {};
+	int fds[2];
+
+	std::cout.flush();
+	if (pipe(fds) != 0)
+		return measure;
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(fds[0]);
+		try {
+			Mesh mesh;
+			resetMemoryPeaks();
+			benchClock::time_point start = benchClock::now();
+			if (loader)
+				loader(file, mesh, &measure.scratch);
+			measure.ms = elapsedMs(start);
+			setMemoryUsage(MEMORY_MESH, mesh.memoryBytes());
+			for (int category = 0; category < MEMORY_CATEGORY_COUNT; category++)
+				measure.memory[category] = getMemoryStats(static_cast<MemoryCategory>(category));
+			measure.triangles = mesh.triangleCount();
+			measure.vertices = static_cast<uint>(mesh.positions.size());
+			measure.ok = true;
+		} catch (std::exception& e) {
+			std::cerr << e.what() << std::endl;
+		}
+		ssize_t written = write(fds[1], &measure, sizeof(measure));
+		(void)written;
+		_exit(0);
+	}
+
+	close(fds[1]);
+	if (pid < 0 || read(fds[0], &measure, sizeof(measure)) != sizeof(measure))
+		measure.ok = false;
+	close(fds[0]);
+
+	int status;
+	struct rusage usage = {};
+	if (pid > 0)
+		wait4(pid, &status, 0, &usage);
+	measure.peakRssKb = usage.ru_maxrss;
+	return measure;
+}
+
+static void	printLoadMeasure(const char* name, const LoadMeasure& measure)
+{
+	std::cout << "\"" << name << "\": { \"ok\": " << (measure.ok ? "true" : "false") << ", \"peakRssKb\": " << measure.peakRssKb
+		<< ", \"ms\": " << measure.ms << ", \"vertices\": " << measure.vertices
+		<< ", \"scratch\": { \"allocations\": " << measure.scratch.allocations << ", \"bytes\": " << measure.scratch.bytes
+		<< ", \"heapBlocks\": " << measure.scratch.blocks << ", \"reservedBytes\": " << measure.scratch.reserved << " }, \"memory\": {";
+	for (int category = 0; category < MEMORY_CATEGORY_COUNT; category++)
+		std::cout << (category ? ", " : " ") << "\"" << memoryCategoryName(static_cast<MemoryCategory>(category)) << "\": { \"bytes\": "
+			<< measure.memory[category].bytes << ", \"peakBytes\": " << measure.memory[category].peakBytes << " }";
+	std::cout << " } }";
+}
+
+struct LoaderBaseline
+{
+	long	peakRssKb;
+	double	ms;
+};
+
+typedef std::unordered_map<std::string, LoaderBaseline>	LoaderBaselines;
+
+static bool	jsonNumber(const std::string& line, const char* key, double& value)
+{
+	std::string pattern = std::string("\"") + key + "\": ";
+	size_t at = line.find(pattern);
+	if (at == std::string::npos)
+		return false;
+	value = std::strtod(line.c_str() + at + pattern.size(), nullptr);
+	return true;
+}
+
+// Loader entries of an earlier --bench output, one per line as printed below.
+// Older outputs with "before" / "after" measures give their first one, the previous loader.
+static LoaderBaselines	readLoaderBaselines(const char* path)
+{
+	LoaderBaselines baselines;
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		std::cerr << "Warning: could not open baseline " << path << std::endl;
+		return baselines;
+	}
+
+	std::string line;
+	bool inLoader = false;
+	while (std::getline(file, line))
+	{
+		if (line.find("\"loaderMemory\"") != std::string::npos)
+			inLoader = true;
+		else if (inLoader && line.find(']') != std::string::npos && line.find('{') == std::string::npos)
+			break;
+		else if (inLoader)
+		{
+			const std::string key = "\"file\": \"";
+			size_t name = line.find(key);
+			double peakRssKb, ms;
+			if (name == std::string::npos || !jsonNumber(line, "peakRssKb", peakRssKb) || !jsonNumber(line, "ms", ms))
+				continue;
+			name += key.size();
+			baselines[line.substr(name, line.find('"', name) - name)] = { static_cast<long>(peakRssKb), ms };
+		}
+	}
+	return baselines;
+}
+
+// Before / after numbers come from a recorded run: save the --bench output of the older
+// revision (built from a git worktree) and pass it with --baseline
+static void	benchLoaderMemory(const char* file, const LoaderBaselines& baselines, bool& first)
+{
+	LoadMeasure baseline = measureLoad(file, nullptr);
+	LoadMeasure loader = measureLoad(file, loadObjMesh);
+
+	std::cout << (first ? "" : ",\n") << "\t\t{ \"file\": \"" << file << "\", \"triangles\": " << loader.triangles
+		<< ", \"baselineRssKb\": " << baseline.peakRssKb << ", ";
+	printLoadMeasure("loader", loader);
+	auto recorded = baselines.find(file);
+	if (recorded != baselines.end())
+		std::cout << ", \"recorded\": { \"peakRssKb\": " << recorded->second.peakRssKb << ", \"ms\": " << recorded->second.ms
+			<< ", \"peakRssRatio\": " << (recorded->second.peakRssKb ? static_cast<double>(loader.peakRssKb) / recorded->second.peakRssKb : 0.0)
+			<< ", \"msRatio\": " << (recorded->second.ms > 0.0 ? loader.ms / recorded->second.ms : 0.0) << " }";
+	std::cout << " }";
+	first = false;
+}
+
+// Wavy grid with v/vt/vn for every vertex, written once and reused by later runs
+static std::string	syntheticMesh(size_t triangles)
+{
+	std::string path = "/tmp/scop_synthetic_" + std::to_string(triangles) + ".obj";
+	if (std::ifstream(path).good())
+		return path;
+
+	size_t quads = (triangles + 1) / 2;
+	size_t n = static_cast<size_t>(std::ceil(std::sqrt(static_cast<double>(quads))));
+	FILE* out = std::fopen(path.c_str(), "w");
+	if (!out)
+		throw std::runtime_error("Error: could not write " + path);
+
+	for (size_t y = 0; y <= n; y++)
+		for (size_t x = 0; x <= n; x++)
+			std::fprintf(out, "v %f %f %f\n", x / (float)n, 0.05f * std::sin(x * 0.1f) * std::cos(y * 0.1f), y / (float)n);
+	for (size_t y = 0; y <= n; y++)
+		for (size_t x = 0; x <= n; x++)
+			std::fprintf(out, "vt %f %f\n", x / (float)n, y / (float)n);
+	for (size_t y = 0; y <= n; y++)
+		for (size_t x = 0; x <= n; x++)
+			std::fprintf(out, "vn 0 1 0\n");
+
+	size_t written = 0;
+	for (size_t y = 0; y < n && written < quads; y++)
+	{
+		for (size_t x = 0; x < n && written < quads; x++, written++)
+		{
+			size_t a = y * (n + 1) + x + 1, b = a + 1, c = a + n + 2, d = a + n + 1;
+			std::fprintf(out, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", a, a, a, d, d, d, c, c, c, b, b, b);
+		}
+	}
+	std::fclose(out);
+	return path;
+}
+
+// 24 bit bottom-up gradient, written once and reused by later runs
+static std::string	syntheticBmp(int size)
+{
+	std::string path = "/tmp/scop_synthetic_" + std::to_string(size) + ".bmp";
+	if (std::ifstream(path).good())
+		return path;
+
+	size_t rowStride = ((size_t)size * 3 + 3) & ~(size_t)3;
+	uint32_t pixelOffset = 54, fileSize = pixelOffset + static_cast<uint32_t>(rowStride * size);
+	unsigned char header[54] = { 'B', 'M' };
+	uint32_t fields[] = { fileSize, 0, pixelOffset, 40, (uint32_t)size, (uint32_t)size };
+	std::memcpy(header + 2, fields, sizeof(fields));
+	header[26] = 1; // planes
+	header[28] = 24; // bits per pixel
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out)
+		throw std::runtime_error("Error: could not write " + path);
+	out.write(reinterpret_cast<const char*>(header), sizeof(header));
+	std::vector<unsigned char> row(rowStride, 0);
+	for (int y = 0; y < size; y++)
+	{
+		for (int x = 0; x < size; x++)
+		{
+			row[x * 3] = static_cast<unsigned char>(x);
+			row[x * 3 + 1] = static_cast<unsigned char>(y);
+			row[x * 3 + 2] = static_cast<unsigned char>(x ^ y);
+		}
+		out.write(reinterpret_cast<const char*>(row.data()), rowStride);
+	}
+	return path;
+}
+
+// Time until the pixels sit in GL order in a staging buffer (the PBO in the viewer).
+// Best of a few runs, so both readers see the file in the page cache.
+static void	benchTextureDecode(const char* file, bool& first)
+{
+	double stbMs = -1.0, bmpMs = -1.0;
+	size_t stbPeakBytes = 0, bmpPeakBytes = 0;
+	int width = 0, height = 0, channels = 0;
+	std::vector<unsigned char> staging;
+
+	stbi_set_flip_vertically_on_load(1);
+	resetMemoryPeaks();
+	for (int run = 0; run < BENCH_TEXTURE_RUNS; run++)
+	{
+		benchClock::time_point start = benchClock::now();
+		unsigned char* data = stbi_load(file, &width, &height, &channels, 0);
+		if (!data)
+			break;
+		size_t size = (size_t)width * height * channels;
+		staging.resize(size);
+		std::memcpy(staging.data(), data, size);
+		stbi_image_free(data);
+		double ms = elapsedMs(start);
+		stbMs = stbMs < 0.0 ? ms : std::min(stbMs, ms);
+	}
+	stbPeakBytes = getMemoryStats(MEMORY_TEXTURES).peakBytes;
+
+	resetMemoryPeaks();
+	for (int run = 0; run < BENCH_TEXTURE_RUNS; run++)
+	{
+		benchClock::time_point start = benchClock::now();
+		BmpImage bmp;
+		if (!bmp.open(file))
+			break;
+		size_t rowStride = bmp.getRowStride();
+		staging.resize(rowStride * bmp.getHeight());
+		if (bmp.isBottomUp())
+			std::memcpy(staging.data(), bmp.getPixels(), staging.size());
+		else
+			for (int y = 0; y < bmp.getHeight(); y++)
+				std::memcpy(staging.data() + y * rowStride, bmp.getRow(y), rowStride);
+		double ms = elapsedMs(start);
+		bmpMs = bmpMs < 0.0 ? ms : std::min(bmpMs, ms);
+	}
+	bmpPeakBytes = getMemoryStats(MEMORY_TEXTURES).peakBytes;
+
+	std::cout << (first ? "" : ",\n") << "\t\t{ \"file\": \"" << file << "\", \"width\": " << width << ", \"height\": " << height
+		<< ", \"channels\": " << channels << ", \"stbMs\": " << stbMs << ", \"bmpMs\": " << bmpMs
+		<< ", \"speedup\": " << (stbMs > 0.0 && bmpMs > 0.0 ? stbMs / bmpMs : 0.0)
+		<< ", \"stbPeakBytes\": " << stbPeakBytes << ", \"bmpPeakBytes\": " << bmpPeakBytes << " }";
+	first = false;
+}
+
+// Same work on 1, 2, 4 ... threads: CPU culling of a tessellated model and a BC7 mip chain.
+// Best of a few runs, with the per-job timings of the job system for the last thread count.
+static void	benchJobScaling(const char* file, uint maxThreads, bool& first)
+{
+	Mesh mesh;
+	loadObjMesh(file, mesh);
+	Vec3 center;
+	float radius;
+	boundingSphere(mesh, center, radius);
+	while (mesh.triangleCount() < BENCH_SCALING_TRIANGLES)
+		tessellate(mesh);
+	buildMeshlets(mesh.positions, mesh.indices, mesh.materialRanges, mesh.meshlets);
+	Mat4 projection = Mat4::perspective(45.0f * M_PI / 180.0f, 16.0f / 9.0f, radius * 0.01f, radius * 10.0f);
+
+	std::vector<unsigned char> image((size_t)BENCH_SCALING_IMAGE * BENCH_SCALING_IMAGE * 4);
+	for (size_t i = 0; i < image.size(); i++)
+		image[i] = static_cast<unsigned char>((i * 2654435761u) >> 13);
+
+	std::vector<uint> threadCounts;
+	for (uint threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+
+	double baseCullMs = 0.0, baseCompressMs = 0.0;
+	for (uint threads : threadCounts)
+	{
+		jobSystem().resize(threads);
+		double cullMs = -1.0, compressMs = -1.0;
+		std::vector<DrawElementsIndirectCommand> commands;
+		MeshletCullStats stats;
+		for (int run = 0; run < BENCH_SCALING_RUNS; run++)
+		{
+			benchClock::time_point start = benchClock::now();
+			for (int step = 0; step < BENCH_ORBIT_STEPS; step++)
+			{
+				float angle = step * 2.0f * M_PI / BENCH_ORBIT_STEPS;
+				Vec3 eye = center + Vec3(std::cos(angle), 0.3f, std::sin(angle)) * radius * 1.1f;
+				cullMeshlets(mesh.meshlets, Mat4(), Mat4::lookAt(eye, center, Vec3(0.0f, 1.0f, 0.0f)) * projection, eye,
+					true, true, commands, stats);
+			}
+			double ms = elapsedMs(start) / BENCH_ORBIT_STEPS;
+			cullMs = cullMs < 0.0 ? ms : std::min(cullMs, ms);
+
+			std::vector<unsigned char> output;
+			start = benchClock::now();
+			compressMipChain(image.data(), BENCH_SCALING_IMAGE, BENCH_SCALING_IMAGE, BLOCK_BC7, output);
+			ms = elapsedMs(start);
+			compressMs = compressMs < 0.0 ? ms : std::min(compressMs, ms);
+		}
+		if (threads == 1)
+		{
+			baseCullMs = cullMs;
+			baseCompressMs = compressMs;
+		}
+
+		std::cout << (first ? "" : ",\n") << "\t\t{ \"file\": \"" << file << "\", \"threads\": " << threads
+			<< ", \"meshlets\": " << mesh.meshlets.size() << ", \"cullMsPerView\": " << cullMs
+			<< ", \"cullSpeedup\": " << baseCullMs / cullMs << ", \"compressMs\": " << compressMs
+			<< ", \"compressSpeedup\": " << baseCompressMs / compressMs << ", \"jobs\": [";
+		std::vector<JobStats> jobStats;
+		jobSystem().collectStats(jobStats);
+		for (size_t i = 0; i < jobStats.size(); i++)
+			std::cout << (i ? ", " : " ") << "{ \"name\": \"" << jobStats[i].name << "\", \"count\": " << jobStats[i].count
+				<< ", \"totalMs\": " << jobStats[i].totalMs << ", \"maxMs\": " << jobStats[i].maxMs << " }";
+		std::cout << " ] }";
+		first = false;
+	}
+	jobSystem().resize(0);
+}
+
+// ./scop --bench [--synthetic [triangles]] [--threads max] [--trace file.json] [--baseline previous.json] [file.obj ...]
+int	runBenchmark(int argc, char** argv)
+{
+	std::vector<const char*> files;
+	size_t syntheticTriangles = 0;
+	uint maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	const char* tracePath = nullptr;
+	LoaderBaselines baselines;
+
+	for (int i = 0; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--synthetic") == 0)
+		{
+			syntheticTriangles = BENCH_SYNTHETIC_TRIANGLES;
+			if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+				syntheticTriangles = std::strtoul(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			maxThreads = std::max(1ul, std::strtoul(argv[++i], nullptr, 10));
+		else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+			tracePath = argv[++i];
+		else if (std::strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+			baselines = readLoaderBaselines(argv[++i]);
+		else
+			files.push_back(argv[i]);
+	}
+	if (files.empty())
+		files.assign(std::begin(defaultModels), std::end(defaultModels));
+	// Recording is cheap but not free, the measures are only traced when asked to
+	setTraceEnabled(tracePath != nullptr);
+	traceThreadName("benchmark");
+
+	try {
+		bool first = true;
+		std::cout << "{\n\t\"meshletCulling\": [\n";
+		for (const char* file : files)
+			benchMeshletCulling(file, first);
+		std::cout << "\n\t],\n";
+
+		std::string synthetic;
+		if (syntheticTriangles > 0)
+			synthetic = syntheticMesh(syntheticTriangles);
+
+		first = true;
+		std::cout << "\t\"loaderMemory\": [\n";
+		for (const char* file : files)
+			benchLoaderMemory(file, baselines, first);
+		if (!synthetic.empty())
+			benchLoaderMemory(synthetic.c_str(), baselines, first);
+		std::cout << "\n\t],\n";
+
+		first = true;
+		std::cout << "\t\"textureDecode\": [\n";
+		for (const char* file : defaultTextures)
+			benchTextureDecode(file, first);
+		benchTextureDecode(syntheticBmp(BENCH_TEXTURE_SIZE).c_str(), first);
+		std::cout << "\n\t],\n";
+
+		first = true;
+		std::cout << "\t\"jobScaling\": [\n";
+		benchJobScaling(files[0], maxThreads, first);
+		std::cout << "\n\t]\n}" << std::endl;
+		if (tracePath)
+			writeTrace(tracePath);
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
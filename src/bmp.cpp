@@ -0,0 +1,171 @@
+#include "../include/Bmp.hpp"
+#include "../include/MemoryStats.hpp"
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define BMP_FILE_HEADER_SIZE	14
+#define BMP_INFO_HEADER_SIZE	40
+#define BMP_BI_RGB				0
+#define BMP_BI_BITFIELDS		3
+
+static uint32_t	readU32(const unsigned char* data)
+{
+	uint32_t value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static uint16_t	readU16(const unsigned char* data)
+{
+	uint16_t value;
+	std::memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+bool	isBmpFile(const std::string& path)
+{
+	static const char extension[] = ".bmp";
+	size_t length = sizeof(extension) - 1;
+	if (path.size() < length)
+		return false;
+	for (size_t i = 0; i < length; i++)
+		if (std::tolower(path[path.size() - length + i]) != extension[i])
+			return false;
+	return true;
+}
+
+BmpImage::BmpImage()
+{
+	this->mapping = nullptr;
+	this->mappingSize = 0;
+	this->pixels = nullptr;
+	this->width = 0;
+	this->height = 0;
+	this->channels = 0;
+	this->rowStride = 0;
+	this->bottomUp = true;
+}
+
+BmpImage::~BmpImage()
+{
+	this->close();
+}
+
+void	BmpImage::close()
+{
+	if (this->mapping)
+	{
+		munmap(this->mapping, this->mappingSize);
+		memoryFreed(MEMORY_TEXTURES, this->mappingSize);
+	}
+	this->mapping = nullptr;
+	this->mappingSize = 0;
+	this->pixels = nullptr;
+}
+
+// Returns false for anything GL cannot read straight from the file, the caller falls back to stb_image
+bool	BmpImage::open(const char* filePathName)
+{
+	this->close();
+
+	int fd = ::open(filePathName, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat info;
+	if (fstat(fd, &info) < 0 || info.st_size < BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE)
+	{
+		::close(fd);
+		return false;
+	}
+	void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+		return false;
+	this->mapping = mapping;
+	this->mappingSize = info.st_size;
+	memoryAllocated(MEMORY_TEXTURES, this->mappingSize);
+
+	const unsigned char* file = static_cast<const unsigned char*>(mapping);
+	const unsigned char* header = file + BMP_FILE_HEADER_SIZE;
+	uint32_t pixelOffset = readU32(file + 10);
+	uint32_t headerSize = readU32(header);
+	int32_t width = static_cast<int32_t>(readU32(header + 4));
+	int32_t height = static_cast<int32_t>(readU32(header + 8));
+	uint16_t bitCount = readU16(header + 14);
+	uint32_t compression = readU32(header + 16);
+
+	bool supported = file[0] == 'B' && file[1] == 'M' && headerSize >= BMP_INFO_HEADER_SIZE
+		&& readU16(header + 12) == 1 && width > 0 && height != 0 && (bitCount == 24 || bitCount == 32);
+	// BI_BITFIELDS masks follow the info header, only the BGRA layout matches GL_BGRA
+	if (supported && compression == BMP_BI_BITFIELDS)
+		supported = bitCount == 32 && this->mappingSize >= BMP_FILE_HEADER_SIZE + BMP_INFO_HEADER_SIZE + 12
+			&& readU32(header + 40) == 0x00FF0000 && readU32(header + 44) == 0x0000FF00 && readU32(header + 48) == 0x000000FF;
+	else if (supported)
+		supported = compression == BMP_BI_RGB;
+	if (!supported)
+	{
+		this->close();
+		return false;
+	}
+
+	this->width = width;
+	this->height = height < 0 ? -height : height;
+	this->bottomUp = height > 0;
+	this->channels = bitCount / 8;
+	this->rowStride = ((size_t)this->width * this->channels + 3) & ~(size_t)3;
+	if (pixelOffset > this->mappingSize || this->mappingSize - pixelOffset < this->rowStride * this->height)
+	{
+		this->close();
+		return false;
+	}
+	this->pixels = file + pixelOffset;
+	// Read ahead now so the rows are resident by the time they are uploaded
+	madvise(this->mapping, this->mappingSize, MADV_SEQUENTIAL);
+	madvise(this->mapping, this->mappingSize, MADV_WILLNEED);
+	return true;
+}
+
+int	BmpImage::getWidth() const
+{
+	return this->width;
+}
+
+int	BmpImage::getHeight() const
+{
+	return this->height;
+}
+
+int	BmpImage::getChannels() const
+{
+	return this->channels;
+}
+
+GLenum	BmpImage::getFormat() const
+{
+	return this->channels == 4 ? GL_BGRA : GL_BGR;
+}
+
+size_t	BmpImage::getRowStride() const
+{
+	return this->rowStride;
+}
+
+bool	BmpImage::isBottomUp() const
+{
+	return this->bottomUp;
+}
+
+const unsigned char*	BmpImage::getPixels() const
+{
+	return this->pixels;
+}
+
+const unsigned char*	BmpImage::getRow(int y) const
+{
+	return this->pixels + (size_t)(this->bottomUp ? y : this->height - 1 - y) * this->rowStride;
+}
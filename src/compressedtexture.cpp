@@ -0,0 +1,195 @@
+#include "../include/CompressedTexture.hpp"
+#include "../include/Texture.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#define DDS_FOURCC(a, b, c, d)	((uint)(a) | ((uint)(b) << 8) | ((uint)(c) << 16) | ((uint)(d) << 24))
+#define DDS_HEADER_SIZE			128 // magic + DDS_HEADER
+#define DDS_DX10_HEADER_SIZE	20
+#define KTX2_HEADER_SIZE		80 // identifier + header + index
+#define KTX2_LEVEL_SIZE			24 // byteOffset, byteLength, uncompressedByteLength
+#define COMPRESSED_MAX_SIZE		32768 // keeps the block counts from overflowing
+
+static const unsigned char	ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+static bool	hasExtension(const std::string& path, const char* extension)
+{
+	size_t length = std::strlen(extension);
+	if (path.size() < length)
+		return false;
+	for (size_t i = 0; i < length; i++)
+		if (std::tolower(path[path.size() - length + i]) != extension[i])
+			return false;
+	return true;
+}
+
+bool	isCompressedTextureFile(const std::string& path)
+{
+	return hasExtension(path, ".dds") || hasExtension(path, ".ktx2");
+}
+
+size_t	compressedLevelSize(BlockFormat format, int width, int height)
+{
+	size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	return blocks * (format == BLOCK_BC1 ? 8 : 16);
+}
+
+GLenum	compressedInternalFormat(BlockFormat format, bool srgb)
+{
+	switch (format)
+	{
+		case BLOCK_BC1:
+			return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+		case BLOCK_BC3:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+		default:
+			return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+	}
+}
+
+// BPTC is core in 4.2, S3TC is an extension every desktop driver exposes
+bool	isCompressedFormatSupported(BlockFormat format)
+{
+	if (format == BLOCK_BC7)
+		return GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_compression_bptc;
+	return GLAD_GL_EXT_texture_compression_s3tc;
+}
+
+static uint	readU32(const unsigned char* p)
+{
+	uint value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static size_t	readU64(const unsigned char* p)
+{
+	unsigned long long value;
+	std::memcpy(&value, p, sizeof(value));
+	return static_cast<size_t>(value);
+}
+
+// Header values are untrusted: the size must be usable and the level count cannot exceed a full chain
+static bool	isValidSize(int width, int height)
+{
+	return width > 0 && height > 0 && width <= COMPRESSED_MAX_SIZE && height <= COMPRESSED_MAX_SIZE;
+}
+
+static bool	isInFile(size_t offset, size_t size, const std::vector<unsigned char>& file)
+{
+	return offset <= file.size() && size <= file.size() - offset;
+}
+
+// Mip levels are stored largest first right after the headers
+static bool	parseDds(CompressedImage& image, std::vector<unsigned char>& file)
+{
+	if (file.size() < DDS_HEADER_SIZE)
+		return false;
+
+	image.height = readU32(&file[12]);
+	image.width = readU32(&file[16]);
+	if (!isValidSize(image.width, image.height))
+		return false;
+	uint mipCount = std::min(std::max(readU32(&file[28]), 1u), static_cast<uint>(mipLevelCount(image.width, image.height)));
+	uint fourCC = readU32(&file[84]);
+	size_t offset = DDS_HEADER_SIZE;
+
+	if (fourCC == DDS_FOURCC('D', 'X', 'T', '1'))
+		image.format = BLOCK_BC1;
+	else if (fourCC == DDS_FOURCC('D', 'X', 'T', '5'))
+		image.format = BLOCK_BC3;
+	else if (fourCC == DDS_FOURCC('D', 'X', '1', '0') && file.size() >= DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE)
+	{
+		uint dxgiFormat = readU32(&file[DDS_HEADER_SIZE]);
+		offset += DDS_DX10_HEADER_SIZE;
+		if (dxgiFormat == 71 || dxgiFormat == 72)
+			image.format = BLOCK_BC1;
+		else if (dxgiFormat == 77 || dxgiFormat == 78)
+			image.format = BLOCK_BC3;
+		else if (dxgiFormat == 98 || dxgiFormat == 99)
+			image.format = BLOCK_BC7;
+		else
+			return false;
+	}
+	else
+		return false;
+
+	int width = image.width, height = image.height;
+	for (uint level = 0; level < mipCount; level++)
+	{
+		size_t size = compressedLevelSize(image.format, width, height);
+		if (!isInFile(offset, size, file))
+			return false;
+		image.levels.push_back({ offset, size, width, height });
+		offset += size;
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	image.data.swap(file);
+	return true;
+}
+
+// Only uncompressed-at-rest 2D images: no supercompression, one layer, one face
+static bool	parseKtx2(CompressedImage& image, std::vector<unsigned char>& file)
+{
+	if (file.size() < KTX2_HEADER_SIZE)
+		return false;
+
+	uint vkFormat = readU32(&file[12]);
+	image.width = readU32(&file[20]);
+	image.height = readU32(&file[24]);
+	uint layerCount = readU32(&file[32]);
+	uint faceCount = readU32(&file[36]);
+	uint levelCount = std::max(readU32(&file[40]), 1u);
+	uint supercompression = readU32(&file[44]);
+	if (!isValidSize(image.width, image.height))
+		return false;
+	levelCount = std::min(levelCount, static_cast<uint>(mipLevelCount(image.width, image.height)));
+
+	if (vkFormat >= 131 && vkFormat <= 134)
+		image.format = BLOCK_BC1;
+	else if (vkFormat == 137 || vkFormat == 138)
+		image.format = BLOCK_BC3;
+	else if (vkFormat == 145 || vkFormat == 146)
+		image.format = BLOCK_BC7;
+	else
+		return false;
+	if (supercompression != 0 || layerCount > 1 || faceCount != 1 || file.size() < KTX2_HEADER_SIZE + (size_t)levelCount * KTX2_LEVEL_SIZE)
+		return false;
+
+	int width = image.width, height = image.height;
+	for (uint level = 0; level < levelCount; level++)
+	{
+		const unsigned char* entry = &file[KTX2_HEADER_SIZE + (size_t)level * KTX2_LEVEL_SIZE];
+		size_t offset = readU64(entry);
+		size_t size = readU64(entry + 8);
+		if (!isInFile(offset, size, file) || size < compressedLevelSize(image.format, width, height))
+			return false;
+		image.levels.push_back({ offset, size, width, height });
+		width = std::max(width / 2, 1);
+		height = std::max(height / 2, 1);
+	}
+	image.data.swap(file);
+	return true;
+}
+
+bool	loadCompressedTexture(const char* filePathName, CompressedImage& image)
+{
+	std::ifstream input(filePathName, std::ios::in | std::ios::binary);
+	if (!input.is_open())
+		return false;
+	std::vector<unsigned char> file((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	image = CompressedImage();
+	bool ok = false;
+	if (file.size() >= 4 && readU32(file.data()) == DDS_FOURCC('D', 'D', 'S', ' '))
+		ok = parseDds(image, file);
+	else if (file.size() >= sizeof(ktx2Identifier) && std::memcmp(file.data(), ktx2Identifier, sizeof(ktx2Identifier)) == 0)
+		ok = parseKtx2(image, file);
+
+	if (!ok)
+		std::cerr << "Warning: unsupported compressed texture " << filePathName << std::endl;
+	return ok;
+}
@@ -0,0 +1,54 @@
+#include "../include/DynamicResolution.hpp"
+#include <algorithm>
+#include <cmath>
+
+DynamicResolution::DynamicResolution()
+{
+	this->scale = 1.0f;
+	this->gpuMs = 0.0;
+	this->headroomMs = 0.0;
+	this->settle = 0;
+}
+
+float	DynamicResolution::update(double gpuMs, double targetMs, float minScale, float maxScale)
+{
+	this->gpuMs = this->gpuMs > 0.0 ? this->gpuMs + (gpuMs - this->gpuMs) * DYNAMIC_RESOLUTION_SMOOTHING : gpuMs;
+	this->headroomMs = targetMs - this->gpuMs;
+
+	float previous = this->scale;
+	if (this->scale > maxScale || this->scale < minScale)
+		this->scale = std::min(std::max(this->scale, minScale), maxScale);
+	else if (this->settle > 0)
+		this->settle--;
+	else
+	{
+		float ideal = this->scale * static_cast<float>(std::sqrt(targetMs * DYNAMIC_RESOLUTION_MARGIN / std::max(this->gpuMs, 0.01)));
+		if (ideal < this->scale - DYNAMIC_RESOLUTION_STEP * 0.5f)
+			this->scale = std::max(std::floor(ideal / DYNAMIC_RESOLUTION_STEP) * DYNAMIC_RESOLUTION_STEP, minScale);
+		else if (ideal >= this->scale + DYNAMIC_RESOLUTION_STEP)
+			this->scale = std::min(this->scale + DYNAMIC_RESOLUTION_STEP, maxScale);
+	}
+
+	if (this->scale != previous)
+	{
+		// until the new measures come in, expect the cost of the new pixel count
+		this->gpuMs *= (this->scale * this->scale) / (previous * previous);
+		this->settle = DYNAMIC_RESOLUTION_SETTLE;
+	}
+	return this->scale;
+}
+
+float	DynamicResolution::getScale() const
+{
+	return this->scale;
+}
+
+double	DynamicResolution::getGpuMs() const
+{
+	return this->gpuMs;
+}
+
+double	DynamicResolution::getHeadroomMs() const
+{
+	return this->headroomMs;
+}
@@ -0,0 +1,51 @@
+#include "../include/FileWatcher.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+FileWatcher::FileWatcher(const char* directory)
+{
+	this->watch = -1;
+	this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (this->fd >= 0)
+		this->watch = inotify_add_watch(this->fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (this->watch < 0)
+	{
+		std::cerr << "Warning: could not watch " << directory << ", shaders will not be reloaded" << std::endl;
+		if (this->fd >= 0)
+			close(this->fd);
+		this->fd = -1;
+	}
+}
+
+FileWatcher::~FileWatcher()
+{
+	if (this->fd >= 0)
+		close(this->fd);
+}
+
+// An editor save usually produces several events for one file, each name is reported once
+bool	FileWatcher::poll(std::vector<std::string>& changed)
+{
+	changed.clear();
+	if (this->fd < 0)
+		return false;
+
+	alignas(struct inotify_event) char buffer[4096];
+	ssize_t length;
+	while ((length = read(this->fd, buffer, sizeof(buffer))) > 0)
+	{
+		for (char* cursor = buffer; cursor < buffer + length; )
+		{
+			const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(cursor);
+			cursor += sizeof(struct inotify_event) + event->len;
+			if (event->len == 0 || (event->mask & IN_ISDIR))
+				continue;
+			std::string name(event->name);
+			if (std::find(changed.begin(), changed.end(), name) == changed.end())
+				changed.push_back(name);
+		}
+	}
+	return !changed.empty();
+}
@@ -0,0 +1,38 @@
+#include "../include/FramePacer.hpp"
+#include <thread>
+
+#define FRAME_PACER_SPIN	std::chrono::microseconds(1000) // busy wait before the deadline
+
+FramePacer::FramePacer()
+{
+	this->period = clock::duration::zero();
+	this->nextFrame = clock::now();
+}
+
+void	FramePacer::setRate(int framesPerSecond)
+{
+	clock::duration period = framesPerSecond > 0
+		? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond)) : clock::duration::zero();
+	if (period != this->period)
+		this->nextFrame = clock::now();
+	this->period = period;
+}
+
+// A frame later than a whole period restarts the timeline instead of rushing to catch up
+void	FramePacer::wait()
+{
+	if (this->period == clock::duration::zero())
+		return;
+
+	clock::time_point now = clock::now();
+	if (now > this->nextFrame + this->period)
+		this->nextFrame = now;
+	else
+	{
+		if (this->nextFrame - now > FRAME_PACER_SPIN)
+			std::this_thread::sleep_until(this->nextFrame - FRAME_PACER_SPIN);
+		while (clock::now() < this->nextFrame)
+			std::this_thread::yield();
+	}
+	this->nextFrame += this->period;
+}
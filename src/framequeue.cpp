@@ -0,0 +1,104 @@
+#include "../include/FrameQueue.hpp"
+
+FramePacket::FramePacket()
+{
+	this->commands.reserve(4);
+}
+
+FramePacket::~FramePacket()
+{
+	for (ImDrawList* list : this->drawLists)
+		IM_DELETE(list);
+}
+
+// The draw lists of ImGui are reused by the next NewFrame, the render thread gets its own copies
+void	FramePacket::setDrawData(const ImDrawData* source)
+{
+	for (ImDrawList* list : this->drawLists)
+		IM_DELETE(list);
+	this->drawLists.clear();
+	this->drawData.Clear();
+	if (!source || !source->Valid)
+		return;
+
+	for (int i = 0; i < source->CmdListsCount; i++)
+		this->drawLists.push_back(source->CmdLists[i]->CloneOutput());
+	this->drawData.Valid = true;
+	for (ImDrawList* list : this->drawLists)
+		this->drawData.AddDrawList(list);
+	this->drawData.DisplayPos = source->DisplayPos;
+	this->drawData.DisplaySize = source->DisplaySize;
+	this->drawData.FramebufferScale = source->FramebufferScale;
+}
+
+FrameQueue::FrameQueue()
+{
+	this->writeIndex = 0;
+	this->readyIndex = -1;
+	this->drawingIndex = -1;
+	this->stopped = false;
+	this->status = RenderStatus();
+}
+
+// Waits while the render thread still draws the packet about to be rewritten
+FramePacket&	FrameQueue::beginWrite()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->changed.wait(lock, [this]() { return this->stopped || this->drawingIndex != this->writeIndex; });
+	return this->packets[this->writeIndex];
+}
+
+// A frame not picked up yet is never dropped, its commands must run
+void	FrameQueue::submit()
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->changed.wait(lock, [this]() { return this->stopped || this->readyIndex < 0; });
+	this->readyIndex = this->writeIndex;
+	this->writeIndex ^= 1;
+	this->changed.notify_all();
+}
+
+bool	FrameQueue::acquire(FramePacket*& packet)
+{
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->changed.wait(lock, [this]() { return this->stopped || this->readyIndex >= 0; });
+	if (this->stopped)
+		return false;
+	this->drawingIndex = this->readyIndex;
+	this->readyIndex = -1;
+	packet = &this->packets[this->drawingIndex];
+	this->changed.notify_all();
+	return true;
+}
+
+void	FrameQueue::release()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->drawingIndex = -1;
+	this->changed.notify_all();
+}
+
+void	FrameQueue::publishStatus(const RenderStatus& status)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->status = status;
+}
+
+void	FrameQueue::readStatus(RenderStatus& status)
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	status = this->status;
+}
+
+void	FrameQueue::stop()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->stopped = true;
+	this->changed.notify_all();
+}
+
+bool	FrameQueue::isStopped()
+{
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->stopped;
+}
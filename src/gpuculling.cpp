@@ -0,0 +1,421 @@
+#include "../include/GpuCulling.hpp"
+#include "../include/MemoryStats.hpp"
+#include "../include/Shader.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#define CULL_GROUP_SIZE		64
+#define PYRAMID_GROUP_SIZE	8
+#define COUNTER_COUNT		5 // visibleMeshlets, renderedTriangles, frustumCulled, backfaceCulled, occlusionCulled, then one draw count per batch
+
+GpuCulling::GpuCulling()
+{
+	this->cullProgram = loadComputeProgram("./ressources/shaders/cull.comp");
+	this->pyramidProgram = loadComputeProgram("./ressources/shaders/hiz.comp");
+	if (this->cullProgram == 0 || this->pyramidProgram == 0)
+	{
+		glDeleteProgram(this->cullProgram);
+		glDeleteProgram(this->pyramidProgram);
+		throw std::runtime_error("Error: could not create culling compute programs");
+	}
+
+	glGenBuffers(1, &this->meshletBuffer);
+	glGenBuffers(1, &this->commandBuffer);
+	glGenBuffers(1, &this->counterBuffer);
+	glGenBuffers(1, &this->batchBuffer);
+	glGenBuffers(CULL_STATS_READBACKS, this->statsBuffers);
+	for (uint buffer : this->statsBuffers)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, COUNTER_COUNT * sizeof(uint), nullptr, GL_STREAM_READ);
+		trackGpuResource(GPU_BUFFER, buffer, "culling stats", COUNTER_COUNT * sizeof(uint));
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	this->meshletCount = 0;
+	this->meshletCapacity = 0;
+	this->submittedTriangles = 0;
+	this->indirectCount = GLAD_GL_VERSION_4_6 || GLAD_GL_ARB_indirect_parameters;
+
+	this->depthTexture = 0;
+	this->pyramidTexture = 0;
+	this->pyramidWidth = 0;
+	this->pyramidHeight = 0;
+	this->pyramidLevels = 0;
+	this->pyramidValid = false;
+
+	for (GLsync& fence : this->statsFences)
+		fence = nullptr;
+	this->statsHead = 0;
+	this->stats = {};
+}
+
+GpuCulling::~GpuCulling()
+{
+	this->dropStats();
+	for (uint buffer : this->statsBuffers)
+		untrackGpuResource(GPU_BUFFER, buffer);
+	glDeleteBuffers(CULL_STATS_READBACKS, this->statsBuffers);
+	glDeleteProgram(this->cullProgram);
+	glDeleteProgram(this->pyramidProgram);
+	glDeleteBuffers(1, &this->meshletBuffer);
+	glDeleteBuffers(1, &this->commandBuffer);
+	glDeleteBuffers(1, &this->counterBuffer);
+	glDeleteBuffers(1, &this->batchBuffer);
+	glDeleteTextures(1, &this->depthTexture);
+	glDeleteTextures(1, &this->pyramidTexture);
+	for (uint buffer : { this->meshletBuffer, this->commandBuffer, this->counterBuffer, this->batchBuffer })
+		untrackGpuResource(GPU_BUFFER, buffer);
+	untrackGpuResource(GPU_TEXTURE, this->depthTexture);
+	untrackGpuResource(GPU_TEXTURE, this->pyramidTexture);
+}
+
+// Both programs are swapped only when both build, the current ones stay otherwise
+bool	GpuCulling::reloadPrograms(std::string& error)
+{
+	uint cullProgram = loadComputeProgram("./ressources/shaders/cull.comp", &error);
+	uint pyramidProgram = cullProgram ? loadComputeProgram("./ressources/shaders/hiz.comp", &error) : 0;
+	if (cullProgram == 0 || pyramidProgram == 0)
+	{
+		glDeleteProgram(cullProgram);
+		return false;
+	}
+
+	glDeleteProgram(this->cullProgram);
+	glDeleteProgram(this->pyramidProgram);
+	this->cullProgram = cullProgram;
+	this->pyramidProgram = pyramidProgram;
+	this->pyramidValid = false;
+	return true;
+}
+
+bool	GpuCulling::isSupported()
+{
+	return GLAD_GL_VERSION_4_3
+		|| (GLAD_GL_ARB_compute_shader && GLAD_GL_ARB_shader_storage_buffer_object && GLAD_GL_ARB_multi_draw_indirect
+			&& GLAD_GL_ARB_shader_image_load_store && GLAD_GL_ARB_clear_buffer_object);
+}
+
+// The meshlets already uploaded are kept, the command slots are rewritten by every dispatch so they are not
+void	GpuCulling::reserveMeshlets(uint count)
+{
+	if (count <= this->meshletCapacity)
+		return;
+
+	uint capacity = std::max(std::max(count, this->meshletCapacity + this->meshletCapacity / 2), 1u);
+	uint meshletBuffer;
+	glGenBuffers(1, &meshletBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, meshletBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)capacity * sizeof(GpuMeshlet), nullptr, GL_STATIC_DRAW);
+	if (this->meshletCount > 0)
+	{
+		glBindBuffer(GL_COPY_READ_BUFFER, this->meshletBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (GLsizeiptr)this->meshletCount * sizeof(GpuMeshlet));
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &this->meshletBuffer);
+	untrackGpuResource(GPU_BUFFER, this->meshletBuffer);
+	this->meshletBuffer = meshletBuffer;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->commandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)capacity * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	this->meshletCapacity = capacity;
+	trackGpuResource(GPU_BUFFER, this->meshletBuffer, "culling meshlets", (size_t)capacity * sizeof(GpuMeshlet));
+	trackGpuResource(GPU_BUFFER, this->commandBuffer, "culling commands", (size_t)capacity * sizeof(DrawElementsIndirectCommand));
+}
+
+// materialBatches[m] is the draw batch (texture) of material m
+void	GpuCulling::uploadMeshlets(const std::vector<Meshlet>& meshlets, const std::vector<uint>& materialBatches)
+{
+	this->meshletCount = 0;
+	this->submittedTriangles = 0;
+	this->batchSizes.assign(1, 0);
+	this->uploadedBatches = materialBatches;
+	// The previous pyramid was rendered with another mesh
+	this->pyramidValid = false;
+	this->appendMeshlets(meshlets, materialBatches);
+}
+
+// A streamed window only adds meshlets: they are binned and copied after the uploaded ones. The pyramid
+// stays valid, new geometry behind what was drawn last frame is hidden all the same.
+void	GpuCulling::appendMeshlets(const std::vector<Meshlet>& meshlets, const std::vector<uint>& materialBatches)
+{
+	// Meshlets already binned to another batch, or a shorter list: start over
+	bool rebinned = meshlets.size() < this->meshletCount || materialBatches.size() < this->uploadedBatches.size()
+		|| !std::equal(this->uploadedBatches.begin(), this->uploadedBatches.end(), materialBatches.begin());
+	if (rebinned)
+	{
+		this->uploadMeshlets(meshlets, materialBatches);
+		return;
+	}
+	this->uploadedBatches = materialBatches;
+
+	uint first = this->meshletCount;
+	std::vector<GpuMeshlet> gpuMeshlets(meshlets.size() - first);
+	for (size_t i = 0; i < gpuMeshlets.size(); i++)
+	{
+		const Meshlet& meshlet = meshlets[first + i];
+		GpuMeshlet& gpu = gpuMeshlets[i];
+
+		gpu = {};
+		gpu.sphere[0] = meshlet.center.x;
+		gpu.sphere[1] = meshlet.center.y;
+		gpu.sphere[2] = meshlet.center.z;
+		gpu.sphere[3] = meshlet.radius;
+		gpu.cone[0] = meshlet.coneAxis.x;
+		gpu.cone[1] = meshlet.coneAxis.y;
+		gpu.cone[2] = meshlet.coneAxis.z;
+		gpu.cone[3] = meshlet.coneCutoff;
+		gpu.firstIndex = meshlet.firstIndex;
+		gpu.indexCount = meshlet.indexCount;
+		gpu.material = meshlet.material;
+		gpu.batch = meshlet.material < materialBatches.size() ? materialBatches[meshlet.material] : 0;
+		if (gpu.batch >= this->batchSizes.size())
+			this->batchSizes.resize(gpu.batch + 1, 0);
+		this->batchSizes[gpu.batch]++;
+		this->submittedTriangles += meshlet.indexCount / 3;
+	}
+
+	this->reserveMeshlets(static_cast<uint>(meshlets.size()));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->meshletBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)first * sizeof(GpuMeshlet), gpuMeshlets.size() * sizeof(GpuMeshlet), gpuMeshlets.data());
+	this->meshletCount = static_cast<uint>(meshlets.size());
+
+	// Batch slots move as batches grow, both small buffers are rewritten
+	this->batchOffsets.assign(this->batchSizes.size(), 0);
+	for (size_t b = 1; b < this->batchSizes.size(); b++)
+		this->batchOffsets[b] = this->batchOffsets[b - 1] + this->batchSizes[b - 1];
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->batchBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, this->batchOffsets.size() * sizeof(uint), this->batchOffsets.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->counterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (COUNTER_COUNT + this->batchSizes.size()) * sizeof(uint), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	trackGpuResource(GPU_BUFFER, this->batchBuffer, "culling commands", this->batchOffsets.size() * sizeof(uint));
+	trackGpuResource(GPU_BUFFER, this->counterBuffer, "culling commands", (COUNTER_COUNT + this->batchSizes.size()) * sizeof(uint));
+
+	// Counters of a dispatch on the previous buffers are meaningless
+	this->dropStats();
+}
+
+void	GpuCulling::dropStats()
+{
+	for (GLsync& fence : this->statsFences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+	this->statsHead = 0;
+}
+
+// Only the copies are read back: the counter buffer itself is cleared and rewritten by every
+// dispatch, reading it would wait for the newest one. Copies finish in order, the first one
+// still running ends the scan, the latest finished one wins.
+void	GpuCulling::readStats()
+{
+	uint counters[COUNTER_COUNT];
+	bool fresh = false;
+
+	for (int i = 0; i < CULL_STATS_READBACKS; i++)
+	{
+		int slot = (this->statsHead + i) % CULL_STATS_READBACKS;
+		if (!this->statsFences[slot])
+			continue;
+		if (glClientWaitSync(this->statsFences[slot], 0, 0) == GL_TIMEOUT_EXPIRED)
+			break;
+		glBindBuffer(GL_COPY_READ_BUFFER, this->statsBuffers[slot]);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(counters), counters);
+		glDeleteSync(this->statsFences[slot]);
+		this->statsFences[slot] = nullptr;
+		fresh = true;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	if (!fresh)
+		return;
+
+	this->stats.submittedTriangles = this->submittedTriangles;
+	this->stats.visibleMeshlets = counters[0];
+	this->stats.renderedTriangles = counters[1];
+	this->stats.frustumCulled = counters[2];
+	this->stats.backfaceCulled = counters[3];
+	this->stats.occlusionCulled = counters[4];
+}
+
+// Every copy still in flight: this frame's counters are skipped rather than waited for
+void	GpuCulling::copyStats()
+{
+	int slot = this->statsHead;
+	if (this->statsFences[slot])
+		return;
+
+	glBindBuffer(GL_COPY_READ_BUFFER, this->counterBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, this->statsBuffers[slot]);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, COUNTER_COUNT * sizeof(uint));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	this->statsFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	this->statsHead = (slot + 1) % CULL_STATS_READBACKS;
+}
+
+void	GpuCulling::cull(const Mat4& model, const Mat4& viewProjection, const Vec3& cameraPos, bool frustumCulling, bool backfaceCulling, bool occlusionCulling)
+{
+	if (this->meshletCount == 0)
+		return;
+
+	this->readStats();
+	if (!occlusionCulling)
+		this->pyramidValid = false;
+	uint zero = 0;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->counterBuffer);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	if (!this->indirectCount)
+	{
+		// Without a GPU draw count every slot is drawn, unused ones must be empty commands
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->commandBuffer);
+		glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+	glUseProgram(this->cullProgram);
+	glUniform1ui(glGetUniformLocation(this->cullProgram, "meshletCount"), this->meshletCount);
+	glUniformMatrix4fv(glGetUniformLocation(this->cullProgram, "model"), 1, GL_FALSE, Mat4::value_ptr(model));
+	glUniform1f(glGetUniformLocation(this->cullProgram, "modelScale"), model.maxScale());
+	glUniform4fv(glGetUniformLocation(this->cullProgram, "frustumPlanes"), 6, &frustum.planes[0][0]);
+	glUniform3f(glGetUniformLocation(this->cullProgram, "cameraPos"), cameraPos.x, cameraPos.y, cameraPos.z);
+	glUniform1i(glGetUniformLocation(this->cullProgram, "frustumCulling"), frustumCulling);
+	glUniform1i(glGetUniformLocation(this->cullProgram, "backfaceCulling"), backfaceCulling);
+	glUniform1i(glGetUniformLocation(this->cullProgram, "occlusionCulling"), occlusionCulling && this->pyramidValid);
+	if (this->pyramidValid)
+	{
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_2D, this->pyramidTexture);
+		glUniform1i(glGetUniformLocation(this->cullProgram, "depthPyramid"), 1);
+		glUniform2f(glGetUniformLocation(this->cullProgram, "pyramidSize"), this->pyramidWidth, this->pyramidHeight);
+		glUniform1i(glGetUniformLocation(this->cullProgram, "pyramidLevels"), this->pyramidLevels);
+		glUniformMatrix4fv(glGetUniformLocation(this->cullProgram, "previousModelViewProjection"), 1, GL_FALSE, Mat4::value_ptr(this->previousModelViewProjection));
+	}
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, this->meshletBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, this->commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, this->counterBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, this->batchBuffer);
+	glDispatchCompute((this->meshletCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	glActiveTexture(GL_TEXTURE0);
+	glUseProgram(0);
+
+	this->copyStats();
+}
+
+// The caller binds the texture of the batch
+void	GpuCulling::draw(uint batch)
+{
+	if (batch >= this->batchSizes.size() || this->batchSizes[batch] == 0)
+		return;
+
+	void* commands = (void*)(this->batchOffsets[batch] * sizeof(DrawElementsIndirectCommand));
+	GLintptr drawCount = (COUNTER_COUNT + batch) * sizeof(uint);
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, this->commandBuffer);
+	if (this->indirectCount)
+	{
+		glBindBuffer(GL_PARAMETER_BUFFER, this->counterBuffer);
+		if (GLAD_GL_VERSION_4_6)
+			glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, commands, drawCount, this->batchSizes[batch], 0);
+		else
+			glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_INT, commands, drawCount, this->batchSizes[batch], 0);
+		glBindBuffer(GL_PARAMETER_BUFFER, 0);
+	}
+	else
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, commands, this->batchSizes[batch], 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void	GpuCulling::resizePyramid(int width, int height)
+{
+	glDeleteTextures(1, &this->depthTexture);
+	glDeleteTextures(1, &this->pyramidTexture);
+	untrackGpuResource(GPU_TEXTURE, this->depthTexture);
+	untrackGpuResource(GPU_TEXTURE, this->pyramidTexture);
+
+	this->pyramidWidth = width;
+	this->pyramidHeight = height;
+	this->pyramidLevels = 1 + static_cast<int>(std::floor(std::log2(std::max(width, height))));
+
+	glGenTextures(1, &this->depthTexture);
+	glBindTexture(GL_TEXTURE_2D, this->depthTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenTextures(1, &this->pyramidTexture);
+	glBindTexture(GL_TEXTURE_2D, this->pyramidTexture);
+	glTexStorage2D(GL_TEXTURE_2D, this->pyramidLevels, GL_R32F, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	trackGpuResource(GPU_TEXTURE, this->depthTexture, "depth pyramid", textureStorageBytes(GL_DEPTH_COMPONENT32F, width, height, 1, 1));
+	trackGpuResource(GPU_TEXTURE, this->pyramidTexture, "depth pyramid", textureStorageBytes(GL_R32F, width, height, 1, this->pyramidLevels));
+}
+
+// Copy the depth buffer of the frame that was just drawn and reduce it into the pyramid
+void	GpuCulling::buildDepthPyramid(int width, int height, const Mat4& modelViewProjection)
+{
+	if (width <= 0 || height <= 0)
+		return;
+	if (width != this->pyramidWidth || height != this->pyramidHeight)
+		this->resizePyramid(width, height);
+
+	glBindTexture(GL_TEXTURE_2D, this->depthTexture);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+	glUseProgram(this->pyramidProgram);
+	glActiveTexture(GL_TEXTURE1);
+	glUniform1i(glGetUniformLocation(this->pyramidProgram, "inputDepth"), 1);
+
+	int inputWidth = width, inputHeight = height;
+	for (int level = 0; level < this->pyramidLevels; level++)
+	{
+		int outputWidth = std::max(width >> level, 1);
+		int outputHeight = std::max(height >> level, 1);
+
+		glBindTexture(GL_TEXTURE_2D, level == 0 ? this->depthTexture : this->pyramidTexture);
+		glUniform1i(glGetUniformLocation(this->pyramidProgram, "inputLevel"), level == 0 ? 0 : level - 1);
+		glUniform2i(glGetUniformLocation(this->pyramidProgram, "inputSize"), inputWidth, inputHeight);
+		glUniform2i(glGetUniformLocation(this->pyramidProgram, "outputSize"), outputWidth, outputHeight);
+		glBindImageTexture(0, this->pyramidTexture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((outputWidth + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, (outputHeight + PYRAMID_GROUP_SIZE - 1) / PYRAMID_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		inputWidth = outputWidth;
+		inputHeight = outputHeight;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glUseProgram(0);
+
+	this->previousModelViewProjection = modelViewProjection;
+	this->pyramidValid = true;
+}
+
+void	GpuCulling::invalidateDepthPyramid()
+{
+	this->pyramidValid = false;
+}
+
+const MeshletCullStats&	GpuCulling::getStats() const
+{
+	return this->stats;
+}
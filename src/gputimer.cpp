@@ -0,0 +1,66 @@
+#include "../include/GpuTimer.hpp"
+
+GpuTimer::GpuTimer()
+{
+	glGenQueries(GPU_TIMER_QUERIES, this->queries);
+	for (int i = 0; i < GPU_TIMER_QUERIES; i++)
+		this->pending[i] = false;
+	this->head = 0;
+	this->active = false;
+	this->fresh = false;
+	this->lastMs = 0.0;
+}
+
+GpuTimer::~GpuTimer()
+{
+	glDeleteQueries(GPU_TIMER_QUERIES, this->queries);
+}
+
+// Queries finish in order, the first one still running ends the scan
+void	GpuTimer::collect()
+{
+	for (int i = 0; i < GPU_TIMER_QUERIES; i++)
+	{
+		int slot = (this->head + i) % GPU_TIMER_QUERIES;
+		if (!this->pending[slot])
+			continue;
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(this->queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(this->queries[slot], GL_QUERY_RESULT, &nanoseconds);
+		this->pending[slot] = false;
+		this->lastMs = nanoseconds / 1e6;
+		this->fresh = true;
+	}
+}
+
+// Every query still in flight: this frame is skipped rather than stalling on the oldest
+void	GpuTimer::begin()
+{
+	this->collect();
+	this->active = !this->pending[this->head];
+	if (this->active)
+		glBeginQuery(GL_TIME_ELAPSED, this->queries[this->head]);
+}
+
+void	GpuTimer::end()
+{
+	if (!this->active)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	this->pending[this->head] = true;
+	this->head = (this->head + 1) % GPU_TIMER_QUERIES;
+	this->active = false;
+}
+
+bool	GpuTimer::poll(double& ms)
+{
+	this->collect();
+	if (!this->fresh)
+		return false;
+	ms = this->lastMs;
+	this->fresh = false;
+	return true;
+}
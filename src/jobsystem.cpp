@@ -0,0 +1,364 @@
+#include "../include/JobSystem.hpp"
+#include "../include/Trace.hpp"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+struct Job
+{
+	const char*				name;
+	std::function<void()>	function;
+	std::atomic<int>		blockers; // unfinished dependencies, plus one while submit() registers them
+	std::mutex				mutex;
+	std::vector<JobHandle>	continuations;
+	bool					finished;
+	std::atomic<bool>		done;
+	std::exception_ptr		error; // its own or the one of a dependency, the function is then skipped
+};
+
+// The pool generation and queue of the running thread, registered again when the pool restarts
+static std::atomic<uint>			generations(0);
+static thread_local uint			threadGeneration = 0;
+static thread_local uint			threadQueue = 0;
+
+static JobHandle	newJob(const char* name, std::function<void()> function, int blockers)
+{
+	JobHandle job = std::make_shared<Job>();
+	job->name = name;
+	job->function = std::move(function);
+	job->blockers = blockers;
+	job->finished = false;
+	job->done = false;
+	return job;
+}
+
+JobSystem&	jobSystem()
+{
+	static JobSystem system;
+	return system;
+}
+
+JobSystem::JobSystem(uint threadCount)
+{
+	this->start(threadCount);
+}
+
+JobSystem::~JobSystem()
+{
+	this->stop();
+}
+
+void	JobSystem::start(uint threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	this->stopping = false;
+	this->queuedJobs = 0;
+	this->threadCount = threadCount;
+	this->externalQueues = 0;
+	this->generation = ++generations;
+	for (uint i = 0; i < threadCount + JOB_EXTERNAL_QUEUES; i++)
+		this->queues.push_back(std::make_unique<Queue>());
+	for (uint i = 1; i < threadCount; i++)
+		this->workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+void	JobSystem::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->sleepMutex);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+	for (std::thread& worker : this->workers)
+		worker.join();
+	this->workers.clear();
+	this->queues.clear();
+}
+
+// The statistics start over with the new threads
+void	JobSystem::resize(uint threadCount)
+{
+	this->stop();
+	this->start(threadCount);
+}
+
+uint	JobSystem::getThreadCount() const
+{
+	return this->threadCount;
+}
+
+// A thread outside the pool takes the next free slot the first time it needs a queue
+uint	JobSystem::currentQueue()
+{
+	if (threadGeneration == this->generation)
+		return threadQueue;
+
+	uint slot = this->externalQueues.load();
+	while (slot < JOB_EXTERNAL_QUEUES && !this->externalQueues.compare_exchange_weak(slot, slot + 1))
+		;
+	threadGeneration = this->generation;
+	threadQueue = slot < JOB_EXTERNAL_QUEUES ? this->threadCount + slot : 0;
+	if (threadQueue == 0)
+		std::cerr << "Warning: every job queue is taken, this thread shares one" << std::endl;
+	return threadQueue;
+}
+
+// The worker deques and the registered ones, the slots after them are still empty
+uint	JobSystem::activeQueues() const
+{
+	return this->threadCount + std::min(this->externalQueues.load(), (uint)JOB_EXTERNAL_QUEUES);
+}
+
+void	JobSystem::workerLoop(uint index)
+{
+	threadGeneration = this->generation;
+	threadQueue = index;
+	traceThreadName(("job worker " + std::to_string(index)).c_str());
+	while (true)
+	{
+		JobHandle job = this->pop(index);
+		if (!job)
+			job = this->steal(index);
+		if (job)
+		{
+			this->execute(job, index);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(this->sleepMutex);
+		this->wake.wait(lock, [this]() { return this->stopping || this->queuedJobs > 0; });
+		if (this->stopping)
+			return;
+	}
+}
+
+// Lands on the deque of the submitting thread, the idle workers are woken to steal it
+void	JobSystem::schedule(const JobHandle& job)
+{
+	Queue& queue = *this->queues[this->currentQueue()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+	}
+	this->queuedJobs++;
+	if (this->workers.empty())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(this->sleepMutex);
+	}
+	this->wake.notify_one();
+}
+
+// Newest first, its data is the most likely to still be in cache
+JobHandle	JobSystem::pop(uint index)
+{
+	Queue& queue = *this->queues[index];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.jobs.empty())
+		return nullptr;
+	JobHandle job = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+	this->queuedJobs--;
+	return job;
+}
+
+// Oldest first, usually the biggest piece of work left by the victim
+JobHandle	JobSystem::steal(uint thief)
+{
+	uint count = this->activeQueues();
+	for (uint i = 1; i < count; i++)
+	{
+		Queue& queue = *this->queues[(thief + i) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+			continue;
+		JobHandle job = std::move(queue.jobs.front());
+		queue.jobs.pop_front();
+		this->queuedJobs--;
+		return job;
+	}
+	return nullptr;
+}
+
+void	JobSystem::execute(const JobHandle& job, uint index)
+{
+	uint64_t start = traceNow();
+	if (!job->error)
+	{
+		try {
+			job->function();
+		} catch (...) {
+			job->error = std::current_exception();
+		}
+	}
+	uint64_t end = traceNow();
+	if (traceEnabled.load(std::memory_order_relaxed))
+		traceEvent(job->name, start, end);
+	this->record(job->name, (end - start) / 1e6, index);
+	job->function = nullptr;
+
+	std::vector<JobHandle> continuations;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->finished = true;
+		continuations.swap(job->continuations);
+	}
+	job->done.store(true, std::memory_order_release);
+
+	for (const JobHandle& continuation : continuations)
+	{
+		if (job->error)
+		{
+			std::lock_guard<std::mutex> lock(continuation->mutex);
+			if (!continuation->error)
+				continuation->error = job->error;
+		}
+		if (continuation->blockers.fetch_sub(1) == 1)
+			this->schedule(continuation);
+	}
+}
+
+JobHandle	JobSystem::submit(const char* name, std::function<void()> function, const std::vector<JobHandle>& dependencies)
+{
+	JobHandle job = newJob(name, std::move(function), static_cast<int>(dependencies.size()) + 1);
+
+	for (const JobHandle& dependency : dependencies)
+	{
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if (!dependency->finished)
+		{
+			dependency->continuations.push_back(job);
+			continue;
+		}
+		if (dependency->error)
+		{
+			std::lock_guard<std::mutex> jobLock(job->mutex);
+			if (!job->error)
+				job->error = dependency->error;
+		}
+		job->blockers--;
+	}
+	if (job->blockers.fetch_sub(1) == 1)
+		this->schedule(job);
+	return job;
+}
+
+// Without workers a job left on the deque of another thread would never run, it is stolen then
+void	JobSystem::wait(const JobHandle& job)
+{
+	uint index = this->currentQueue();
+	while (!job->done.load(std::memory_order_acquire))
+	{
+		JobHandle next = this->pop(index);
+		if (!next && this->workers.empty())
+			next = this->steal(index);
+		if (next)
+			this->execute(next, index);
+		else
+			std::this_thread::yield();
+	}
+	if (job->error)
+		std::rethrow_exception(job->error);
+}
+
+// Every job is finished on return, even when an earlier one threw
+void	JobSystem::wait(const std::vector<JobHandle>& jobs)
+{
+	std::exception_ptr error;
+	for (const JobHandle& job : jobs)
+	{
+		try {
+			this->wait(job);
+		} catch (...) {
+			if (!error)
+				error = std::current_exception();
+		}
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
+
+// Chunks are handed out through a shared counter, a helper that starts late simply finds none left
+void	JobSystem::parallelFor(const char* name, size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+	if (count == 0)
+		return;
+	grain = std::max(grain, (size_t)1);
+	size_t chunks = (count + grain - 1) / grain;
+	std::atomic<size_t> next(0);
+
+	auto loop = [&]() {
+		try {
+			for (size_t chunk = next++; chunk < chunks; chunk = next++)
+				body(chunk * grain, std::min(count, (chunk + 1) * grain));
+		} catch (...) {
+			next = chunks;
+			throw;
+		}
+	};
+
+	size_t helpers = std::min(chunks, (size_t)this->getThreadCount()) - 1;
+	std::vector<JobHandle> jobs;
+	for (size_t i = 0; i < helpers; i++)
+		jobs.push_back(this->submit(name, loop));
+
+	JobHandle own = newJob(name, loop, 0);
+	this->execute(own, this->currentQueue());
+	std::exception_ptr error = own->error;
+	try {
+		this->wait(jobs);
+	} catch (...) {
+		if (!error)
+			error = std::current_exception();
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void	JobSystem::record(const char* name, double ms, uint index)
+{
+	Queue& queue = *this->queues[index];
+	std::lock_guard<std::mutex> lock(queue.statsMutex);
+	JobStats& stats = queue.stats[name];
+	if (stats.count == 0)
+	{
+		stats.name = name;
+		stats.totalMs = 0.0;
+		stats.maxMs = 0.0;
+	}
+	stats.count++;
+	stats.totalMs += ms;
+	stats.maxMs = std::max(stats.maxMs, ms);
+}
+
+void	JobSystem::collectStats(std::vector<JobStats>& stats)
+{
+	stats.clear();
+	for (const std::unique_ptr<Queue>& queue : this->queues)
+	{
+		std::lock_guard<std::mutex> lock(queue->statsMutex);
+		for (const auto& entry : queue->stats)
+		{
+			auto it = std::find_if(stats.begin(), stats.end(), [&](const JobStats& s) { return s.name == entry.second.name; });
+			if (it == stats.end())
+			{
+				stats.push_back(entry.second);
+				continue;
+			}
+			it->count += entry.second.count;
+			it->totalMs += entry.second.totalMs;
+			it->maxMs = std::max(it->maxMs, entry.second.maxMs);
+		}
+	}
+	std::sort(stats.begin(), stats.end(), [](const JobStats& a, const JobStats& b) { return a.totalMs > b.totalMs; });
+}
+
+void	JobSystem::resetStats()
+{
+	for (const std::unique_ptr<Queue>& queue : this->queues)
+	{
+		std::lock_guard<std::mutex> lock(queue->statsMutex);
+		queue->stats.clear();
+	}
+}
@@ -0,0 +1,122 @@
+#include "../include/Mesh.hpp"
+#include "../include/ObjStream.hpp"
+#include "../include/Trace.hpp"
+#include <climits>
+#include <cfloat>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+Mesh::Mesh() : boundsMin(FLT_MAX, FLT_MAX, FLT_MAX), boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX)
+{
+}
+
+void	Mesh::clear()
+{
+	this->positions.clear();
+	this->texcoords.clear();
+	this->normals.clear();
+	this->indices.clear();
+	this->meshlets.clear();
+	this->materials.clear();
+	this->materialRanges.clear();
+	this->boundsMin = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	this->boundsMax = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+}
+
+void	Mesh::computeBounds()
+{
+	for (const Vec3& position : this->positions)
+	{
+		this->boundsMin = Vec3::min(this->boundsMin, position);
+		this->boundsMax = Vec3::max(this->boundsMax, position);
+	}
+}
+
+void	Mesh::mergeBounds(const Mesh& other)
+{
+	this->boundsMin = Vec3::min(this->boundsMin, other.boundsMin);
+	this->boundsMax = Vec3::max(this->boundsMax, other.boundsMax);
+}
+
+uint	Mesh::triangleCount() const
+{
+	return static_cast<uint>(this->indices.size() / 3);
+}
+
+size_t	Mesh::memoryBytes() const
+{
+	return this->positions.capacity() * sizeof(Vec3) + this->texcoords.capacity() * sizeof(TextureCoord)
+		+ this->normals.capacity() * sizeof(Vec3) + this->indices.capacity() * sizeof(uint)
+		+ this->meshlets.capacity() * sizeof(Meshlet) + this->materials.capacity() * sizeof(Material)
+		+ this->materialRanges.capacity() * sizeof(MaterialRange);
+}
+
+// Pre-count pass: only line prefixes and face corners are looked at, nothing is parsed
+ObjCounts	countObjElements(const char* filePathName)
+{
+	TRACE_SCOPE("countObjElements");
+	std::ifstream objFile(filePathName, std::ios::in | std::ios::binary);
+	ObjCounts counts = {};
+	std::string line;
+
+	if (!objFile.is_open())
+	{
+		std::cerr << "Error: could not open file" << std::endl;
+		throw std::runtime_error("Error: could not open file");
+	}
+
+	while (std::getline(objFile, line))
+	{
+		if (line.size() < 2)
+			continue;
+		if (line[0] == 'v' && line[1] == ' ')
+			counts.positions++;
+		else if (line[0] == 'v' && line[1] == 't')
+			counts.texcoords++;
+		else if (line[0] == 'v' && line[1] == 'n')
+			counts.normals++;
+		else if (line[0] == 'f' && line[1] == ' ')
+		{
+			size_t corners = 0;
+			for (size_t i = 1; i + 1 < line.size(); i++)
+				if ((line[i] == ' ' || line[i] == '\t') && line[i + 1] != ' ' && line[i + 1] != '\t' && line[i + 1] != '\r')
+					corners++;
+			if (corners >= 3)
+				counts.triangles += corners - 2;
+		}
+	}
+	return counts;
+}
+
+// Parser pools are sized by the pre-count pass and the whole scratch memory is returned at once
+// when the stream goes out of scope. The output arrays and the dedup table are sized on the
+// largest attribute pool: a file with more distinct v/vt/vn triples than that still grows them,
+// reserving on the face corner count instead would cost several times the mesh.
+void	loadObjMesh(const char* filePathName, Mesh& mesh, ArenaStats* scratchStats)
+{
+	TRACE_SCOPE("loadObjMesh");
+	ObjCounts counts = countObjElements(filePathName);
+
+	mesh.clear();
+	mesh.indices.reserve(counts.triangles * 3);
+	size_t vertices = std::max(counts.positions, std::max(counts.texcoords, counts.normals));
+	mesh.positions.reserve(vertices);
+	mesh.texcoords.reserve(vertices);
+	mesh.normals.reserve(vertices);
+
+	// The whole file is a single window, the pools and the dedup table die with the stream
+	{
+		Arena arena(ARENA_BLOCK_SIZE, trackedResource(MEMORY_PARSER_SCRATCH));
+		ObjStream stream(filePathName, &arena);
+		stream.reserve(counts, vertices);
+		stream.readWindow(mesh, UINT_MAX);
+
+		if (scratchStats)
+		{
+			*scratchStats = arena.getStats();
+			*scratchStats += stream.getWindowStats();
+		}
+	}
+}
@@ -1,7 +1,15 @@
 #include "../include/Scop.hpp"
+#include "../include/Benchmark.hpp"
+#include "../include/TextureCompressor.hpp"
+#include <cstring>
 
-int main()
+int main(int argc, char** argv)
 {
+	if (argc > 1 && std::strcmp(argv[1], "--bench") == 0)
+		return runBenchmark(argc - 2, argv + 2);
+	if (argc > 1 && std::strcmp(argv[1], "--compress") == 0)
+		return runTextureCompressor(argc - 2, argv + 2);
+
 	try {
 		Scop scop;
 
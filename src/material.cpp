@@ -0,0 +1,77 @@
+#include "../include/Material.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+Material::Material() : diffuse(1.0f, 1.0f, 1.0f), specular(1.0f, 1.0f, 1.0f), shininess(32.0f)
+{
+}
+
+// Directory part of a path including the trailing slash, empty for a bare file name
+std::string	directoryOf(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+static Vec3	parseColor(const char* cursor)
+{
+	char* end;
+	Vec3 color;
+	color.x = std::strtof(cursor, &end);
+	color.y = std::strtof(end, &end);
+	color.z = std::strtof(end, &end);
+	return color;
+}
+
+// Append the materials of an MTL file, a missing library only leaves its materials undefined
+bool	loadMtlFile(const char* filePathName, std::vector<Material>& materials)
+{
+	std::ifstream mtlFile(filePathName);
+	if (!mtlFile.is_open())
+	{
+		std::cerr << "Warning: could not open material library " << filePathName << std::endl;
+		return false;
+	}
+
+	std::string directory = directoryOf(filePathName);
+	std::string line;
+	Material* current = nullptr;
+
+	while (std::getline(mtlFile, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos)
+			continue;
+		const char* cursor = line.c_str() + start;
+
+		if (line.compare(start, 7, "newmtl ") == 0)
+		{
+			if (materials.size() >= MATERIAL_MAX_COUNT)
+			{
+				std::cerr << "Warning: more than " << MATERIAL_MAX_COUNT << " materials, the rest use the default one" << std::endl;
+				break;
+			}
+			materials.emplace_back();
+			current = &materials.back();
+			current->name = line.substr(line.find_first_not_of(" \t", start + 7));
+		}
+		else if (!current)
+			continue;
+		else if (line.compare(start, 3, "Kd ") == 0)
+			current->diffuse = parseColor(cursor + 3);
+		else if (line.compare(start, 3, "Ks ") == 0)
+			current->specular = parseColor(cursor + 3);
+		else if (line.compare(start, 3, "Ns ") == 0)
+			current->shininess = std::max(std::strtof(cursor + 3, nullptr), 1.0f);
+		else if (line.compare(start, 7, "map_Kd ") == 0)
+		{
+			// Options (-s, -o, ...) come first, the file name is the last token
+			size_t name = line.find_last_of(" \t");
+			current->diffuseMap = directory + line.substr(name + 1);
+		}
+	}
+	return true;
+}
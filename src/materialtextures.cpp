@@ -0,0 +1,211 @@
+#include "../include/MaterialTextures.hpp"
+#include "../include/MemoryStats.hpp"
+#include "../imgui/stb_image.h"
+#include <iostream>
+
+MaterialTextures::MaterialTextures()
+{
+	this->srgb = false;
+}
+
+// Only affects arrays created afterwards
+void	MaterialTextures::setSrgb(bool srgb)
+{
+	this->srgb = srgb;
+}
+
+MaterialTextures::~MaterialTextures()
+{
+	this->clear();
+}
+
+void	MaterialTextures::clear()
+{
+	for (TextureArray& array : this->arrays)
+	{
+		glDeleteTextures(1, &array.texture);
+		untrackGpuResource(GPU_TEXTURE, array.texture);
+	}
+	this->arrays.clear();
+	this->locations.clear();
+}
+
+uint	MaterialTextures::getBatchCount() const
+{
+	return this->arrays.empty() ? 1 : static_cast<uint>(this->arrays.size());
+}
+
+void	MaterialTextures::bind(uint batch) const
+{
+	glActiveTexture(GL_TEXTURE0 + MATERIAL_TEXTURE_UNIT);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, batch < this->arrays.size() ? this->arrays[batch].texture : 0);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+// Only the header is read here, the pixels are decoded when the array is uploaded
+MaterialTextures::Location	MaterialTextures::addTexture(const std::string& path)
+{
+	auto it = this->locations.find(path);
+	if (it != this->locations.end())
+		return it->second;
+
+	Location location = { -1, -1 };
+	bool compressed = isCompressedTextureFile(path);
+	CompressedImage image;
+	BmpImage bmp;
+	int width, height, channels, levels;
+	TextureFormat format;
+
+	if (!compressed && isBmpFile(path) && bmp.open(path.c_str()))
+	{
+		width = bmp.getWidth();
+		height = bmp.getHeight();
+		levels = mipLevelCount(width, height);
+		format = textureFormatFor(bmp.getChannels(), this->srgb);
+	}
+	else if (compressed && loadCompressedTexture(path.c_str(), image) && isCompressedFormatSupported(image.format))
+	{
+		width = image.width;
+		height = image.height;
+		levels = static_cast<int>(image.levels.size());
+		format = { compressedInternalFormat(image.format, this->srgb), 0, 4 };
+	}
+	else if (!compressed && stbi_info(path.c_str(), &width, &height, &channels))
+	{
+		levels = mipLevelCount(width, height);
+		format = textureFormatFor(channels, this->srgb);
+	}
+	else
+	{
+		std::cerr << "Warning: could not load texture " << path << std::endl;
+		this->locations.emplace(path, location);
+		return location;
+	}
+
+	size_t index = 0;
+	while (index < this->arrays.size() && (this->arrays[index].width != width || this->arrays[index].height != height
+		|| this->arrays[index].format.internalFormat != format.internalFormat || this->arrays[index].levels != levels))
+		index++;
+	if (index == this->arrays.size())
+		this->arrays.push_back({ width, height, format, compressed, levels, 0, {}, true });
+
+	TextureArray& array = this->arrays[index];
+	location.array = static_cast<int>(index);
+	location.layer = static_cast<int>(array.layers.size());
+	array.layers.push_back(path);
+	array.dirty = true;
+	this->locations.emplace(path, location);
+	return location;
+}
+
+// Immutable storage cannot grow, an array that gained layers is rebuilt from its files
+void	MaterialTextures::upload(TextureArray& array)
+{
+	glDeleteTextures(1, &array.texture);
+	untrackGpuResource(GPU_TEXTURE, array.texture);
+	glGenTextures(1, &array.texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+	glTexStorage3D(GL_TEXTURE_2D_ARRAY, array.levels, array.format.internalFormat, array.width, array.height, array.layers.size());
+	trackGpuResource(GPU_TEXTURE, array.texture, "material arrays",
+		textureStorageBytes(array.format.internalFormat, array.width, array.height, array.layers.size(), array.levels));
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, array.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	array.dirty = false;
+	if (array.compressed)
+	{
+		this->uploadCompressed(array);
+		return;
+	}
+
+	applyTextureSwizzle(GL_TEXTURE_2D_ARRAY, array.format);
+	setUnpackAlignment((GLsizeiptr)array.width * array.format.channels);
+
+	for (size_t layer = 0; layer < array.layers.size(); layer++)
+	{
+		if (this->uploadBmp(array, layer))
+			continue;
+
+		int width, height, channels;
+		unsigned char* data = stbi_load(array.layers[layer].c_str(), &width, &height, &channels, array.format.channels);
+		if (!data || width != array.width || height != array.height)
+		{
+			std::cerr << "Warning: could not load texture " << array.layers[layer] << std::endl;
+			stbi_image_free(data);
+			continue;
+		}
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, array.format.format, GL_UNSIGNED_BYTE, data);
+		stbi_image_free(data);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Straight from the mapped file, one call for bottom-up files and one per row otherwise
+bool	MaterialTextures::uploadBmp(const TextureArray& array, size_t layer)
+{
+	BmpImage bmp;
+	if (!isBmpFile(array.layers[layer]) || !bmp.open(array.layers[layer].c_str()) || bmp.getWidth() != array.width
+		|| bmp.getHeight() != array.height || bmp.getChannels() != array.format.channels)
+		return false;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (bmp.isBottomUp())
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, bmp.getWidth(), bmp.getHeight(), 1, bmp.getFormat(), GL_UNSIGNED_BYTE, bmp.getPixels());
+	else
+		for (int y = 0; y < bmp.getHeight(); y++)
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, y, layer, bmp.getWidth(), 1, 1, bmp.getFormat(), GL_UNSIGNED_BYTE, bmp.getRow(y));
+	setUnpackAlignment((GLsizeiptr)array.width * array.format.channels);
+	return true;
+}
+
+// Every level comes from the file, nothing is generated
+void	MaterialTextures::uploadCompressed(TextureArray& array)
+{
+	for (size_t layer = 0; layer < array.layers.size(); layer++)
+	{
+		CompressedImage image;
+		if (!loadCompressedTexture(array.layers[layer].c_str(), image) || image.width != array.width
+			|| image.height != array.height || static_cast<int>(image.levels.size()) != array.levels)
+		{
+			std::cerr << "Warning: could not load texture " << array.layers[layer] << std::endl;
+			continue;
+		}
+		for (size_t level = 0; level < image.levels.size(); level++)
+		{
+			const CompressedLevel& mip = image.levels[level];
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, mip.width, mip.height, 1, array.format.internalFormat,
+				compressedLevelSize(image.format, mip.width, mip.height), image.data.data() + mip.offset);
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// Fill the texture layer of every material and its draw batch (the array holding its texture).
+// Untextured materials (layer -1) sample the global texture and can be drawn in any batch.
+void	MaterialTextures::update(const std::vector<Material>& materials, std::vector<GpuMaterial>& gpuMaterials, std::vector<uint>& materialBatches)
+{
+	gpuMaterials.resize(materials.size());
+	materialBatches.assign(materials.size(), 0);
+
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		const Material& material = materials[i];
+		gpuMaterials[i] = { material.diffuse, material.shininess, material.specular, -1 };
+		if (material.diffuseMap.empty())
+			continue;
+
+		Location location = this->addTexture(material.diffuseMap);
+		if (location.array < 0)
+			continue;
+		gpuMaterials[i].layer = location.layer;
+		materialBatches[i] = location.array;
+	}
+
+	for (TextureArray& array : this->arrays)
+		if (array.dirty)
+			this->upload(array);
+}
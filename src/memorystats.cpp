@@ -0,0 +1,239 @@
+#include "../include/MemoryStats.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+
+struct MemoryCounter
+{
+	std::atomic<size_t>	bytes{0};
+	std::atomic<size_t>	peakBytes{0};
+	std::atomic<size_t>	allocations{0};
+};
+
+static MemoryCounter	counters[MEMORY_CATEGORY_COUNT];
+
+static void	raisePeak(MemoryCounter& counter, size_t bytes)
+{
+	size_t peak = counter.peakBytes.load(std::memory_order_relaxed);
+	while (bytes > peak && !counter.peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+		;
+}
+
+void	memoryAllocated(MemoryCategory category, size_t bytes)
+{
+	MemoryCounter& counter = counters[category];
+	counter.allocations.fetch_add(1, std::memory_order_relaxed);
+	raisePeak(counter, counter.bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void	memoryFreed(MemoryCategory category, size_t bytes)
+{
+	MemoryCounter& counter = counters[category];
+	counter.allocations.fetch_sub(1, std::memory_order_relaxed);
+	counter.bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void	setMemoryUsage(MemoryCategory category, size_t bytes)
+{
+	MemoryCounter& counter = counters[category];
+	counter.bytes.store(bytes, std::memory_order_relaxed);
+	raisePeak(counter, bytes);
+}
+
+void	resetMemoryPeaks()
+{
+	for (MemoryCounter& counter : counters)
+		counter.peakBytes.store(counter.bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+MemoryCategoryStats	getMemoryStats(MemoryCategory category)
+{
+	const MemoryCounter& counter = counters[category];
+	return { counter.bytes.load(std::memory_order_relaxed), counter.peakBytes.load(std::memory_order_relaxed),
+		counter.allocations.load(std::memory_order_relaxed) };
+}
+
+const char*	memoryCategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+		case MEMORY_PARSER_SCRATCH:	return "parser scratch";
+		case MEMORY_MESH:			return "mesh";
+		case MEMORY_TEXTURES:		return "textures";
+		case MEMORY_UI:				return "ui";
+		default:					return "unknown";
+	}
+}
+
+// Keeps the pointer handed out aligned like malloc's
+struct alignas(std::max_align_t) AllocationHeader
+{
+	size_t			size;
+	MemoryCategory	category;
+};
+
+void*	trackedMalloc(MemoryCategory category, size_t size)
+{
+	AllocationHeader* header = static_cast<AllocationHeader*>(std::malloc(sizeof(AllocationHeader) + size));
+	if (!header)
+		return nullptr;
+	header->size = size;
+	header->category = category;
+	memoryAllocated(category, size);
+	return header + 1;
+}
+
+void*	trackedRealloc(MemoryCategory category, void* pointer, size_t size)
+{
+	if (!pointer)
+		return trackedMalloc(category, size);
+	AllocationHeader* header = static_cast<AllocationHeader*>(pointer) - 1;
+	AllocationHeader previous = *header;
+	header = static_cast<AllocationHeader*>(std::realloc(header, sizeof(AllocationHeader) + size));
+	if (!header)
+		return nullptr;
+	memoryFreed(previous.category, previous.size);
+	header->size = size;
+	header->category = category;
+	memoryAllocated(category, size);
+	return header + 1;
+}
+
+void	trackedFree(void* pointer)
+{
+	if (!pointer)
+		return;
+	AllocationHeader* header = static_cast<AllocationHeader*>(pointer) - 1;
+	memoryFreed(header->category, header->size);
+	std::free(header);
+}
+
+class TrackedResource : public std::pmr::memory_resource
+{
+	public:
+		explicit TrackedResource(MemoryCategory category) : category(category) {}
+
+	private:
+		MemoryCategory	category;
+
+		void*	do_allocate(size_t bytes, size_t alignment) override
+		{
+			void* pointer = ::operator new(bytes, std::align_val_t(alignment));
+			memoryAllocated(this->category, bytes);
+			return pointer;
+		}
+
+		void	do_deallocate(void* pointer, size_t bytes, size_t alignment) override
+		{
+			memoryFreed(this->category, bytes);
+			::operator delete(pointer, bytes, std::align_val_t(alignment));
+		}
+
+		bool	do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+		{
+			return this == &other;
+		}
+};
+
+std::pmr::memory_resource*	trackedResource(MemoryCategory category)
+{
+	static TrackedResource resources[MEMORY_CATEGORY_COUNT] = {
+		TrackedResource(MEMORY_PARSER_SCRATCH), TrackedResource(MEMORY_MESH),
+		TrackedResource(MEMORY_TEXTURES), TrackedResource(MEMORY_UI),
+	};
+	return &resources[category];
+}
+
+struct GpuResource
+{
+	const char*	label;
+	size_t		bytes;
+};
+
+// Buffer, texture and renderbuffer names are separate namespaces in GL, the kind goes in the high bits
+static std::mutex								gpuMutex;
+static std::unordered_map<uint64_t, GpuResource>	gpuResources;
+
+static uint64_t	gpuKey(GpuResourceKind kind, uint name)
+{
+	return (static_cast<uint64_t>(kind) << 32) | name;
+}
+
+void	trackGpuResource(GpuResourceKind kind, uint name, const char* label, size_t bytes)
+{
+	if (name == 0)
+		return;
+	std::lock_guard<std::mutex> lock(gpuMutex);
+	gpuResources[gpuKey(kind, name)] = { label, bytes };
+}
+
+void	untrackGpuResource(GpuResourceKind kind, uint name)
+{
+	std::lock_guard<std::mutex> lock(gpuMutex);
+	gpuResources.erase(gpuKey(kind, name));
+}
+
+void	collectGpuUsage(std::vector<GpuResourceUsage>& usage)
+{
+	usage.clear();
+	{
+		std::lock_guard<std::mutex> lock(gpuMutex);
+		for (const auto& entry : gpuResources)
+		{
+			auto it = std::find_if(usage.begin(), usage.end(), [&](const GpuResourceUsage& u) { return std::strcmp(u.label, entry.second.label) == 0; });
+			if (it == usage.end())
+			{
+				usage.push_back({ entry.second.label, 1, entry.second.bytes });
+				continue;
+			}
+			it->count++;
+			it->bytes += entry.second.bytes;
+		}
+	}
+	std::sort(usage.begin(), usage.end(), [](const GpuResourceUsage& a, const GpuResourceUsage& b) { return a.bytes > b.bytes; });
+}
+
+// What the driver has to keep at the least, drivers pad RGB8 to four bytes
+size_t	textureStorageBytes(GLenum internalFormat, int width, int height, int layers, int levels)
+{
+	size_t blockBytes = 0;
+	size_t texelBytes = 4;
+	switch (internalFormat)
+	{
+		case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+		case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+			blockBytes = 8;
+			break;
+		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+		case GL_COMPRESSED_RGBA_BPTC_UNORM:
+		case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+			blockBytes = 16;
+			break;
+		case GL_R8:
+			texelBytes = 1;
+			break;
+		case GL_RG8:
+			texelBytes = 2;
+			break;
+		default:
+			break;
+	}
+
+	size_t total = 0;
+	for (int level = 0; level < levels; level++)
+	{
+		size_t w = std::max(1, width >> level);
+		size_t h = std::max(1, height >> level);
+		if (blockBytes)
+			total += ((w + 3) / 4) * ((h + 3) / 4) * blockBytes;
+		else
+			total += w * h * texelBytes;
+	}
+	return total * std::max(1, layers);
+}
@@ -0,0 +1,241 @@
+#include "../include/Meshlet.hpp"
+#include "../include/JobSystem.hpp"
+#include "../include/Trace.hpp"
+#include <cfloat>
+#include <climits>
+
+Frustum	Frustum::fromMatrix(const Mat4& m)
+{
+	// Gribb-Hartmann extraction, rows are read from the column-major storage
+	Frustum	frustum;
+	float	row[4][4];
+
+	for (int r = 0; r < 4; r++)
+		for (int c = 0; c < 4; c++)
+			row[r][c] = m.data[c * 4 + r];
+
+	for (int i = 0; i < 3; i++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			frustum.planes[i * 2][c] = row[3][c] + row[i][c];
+			frustum.planes[i * 2 + 1][c] = row[3][c] - row[i][c];
+		}
+	}
+
+	for (int i = 0; i < 6; i++)
+	{
+		float* p = frustum.planes[i];
+		float len = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		if (len != 0.0f)
+			for (int c = 0; c < 4; c++)
+				p[c] /= len;
+	}
+	return frustum;
+}
+
+bool	Frustum::intersectsSphere(const Vec3& center, float radius) const
+{
+	for (int i = 0; i < 6; i++)
+	{
+		const float* p = this->planes[i];
+		if (p[0] * center.x + p[1] * center.y + p[2] * center.z + p[3] < -radius)
+			return false;
+	}
+	return true;
+}
+
+static void	computeMeshletBounds(const std::vector<Vec3>& positions, const std::vector<uint>& indices, Meshlet& meshlet)
+{
+	Vec3 min = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vec3 max = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	Vec3 normalSum;
+	uint end = meshlet.firstIndex + meshlet.indexCount;
+
+	for (uint i = meshlet.firstIndex; i < end; i += 3)
+	{
+		const Vec3& v0 = positions[indices[i]];
+		const Vec3& v1 = positions[indices[i + 1]];
+		const Vec3& v2 = positions[indices[i + 2]];
+
+		min = Vec3::min(min, Vec3::min(v0, Vec3::min(v1, v2)));
+		max = Vec3::max(max, Vec3::max(v0, Vec3::max(v1, v2)));
+		normalSum += Vec3::normalize(Vec3::cross(v1 - v0, v2 - v0));
+	}
+
+	meshlet.center = (min + max) * 0.5f;
+	meshlet.radius = 0.0f;
+	for (uint i = meshlet.firstIndex; i < end; i++)
+		meshlet.radius = std::max(meshlet.radius, Vec3::length(positions[indices[i]] - meshlet.center));
+
+	// The cone contains every triangle normal, its cutoff is the sine of the half angle
+	meshlet.coneAxis = Vec3::normalize(normalSum);
+	meshlet.coneCutoff = 1.0f;
+	if (Vec3::length(meshlet.coneAxis) == 0.0f)
+		return;
+
+	float minDot = 1.0f;
+	for (uint i = meshlet.firstIndex; i < end; i += 3)
+	{
+		const Vec3& v0 = positions[indices[i]];
+		Vec3 normal = Vec3::normalize(Vec3::cross(positions[indices[i + 1]] - v0, positions[indices[i + 2]] - v0));
+		if (Vec3::length(normal) != 0.0f)
+			minDot = std::min(minDot, Vec3::dot(normal, meshlet.coneAxis));
+	}
+	if (minDot > 0.0f)
+		meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+// Number of vertices of triangle i that the meshlet meshletId does not reference yet
+static uint	countNewVertices(const std::vector<uint>& indices, uint i, const std::vector<uint>& lastMeshlet, uint meshletId)
+{
+	uint a = indices[i], b = indices[i + 1], c = indices[i + 2];
+	uint count = 0;
+
+	if (lastMeshlet[a] != meshletId)
+		count++;
+	if (lastMeshlet[b] != meshletId && b != a)
+		count++;
+	if (lastMeshlet[c] != meshletId && c != a && c != b)
+		count++;
+	return count;
+}
+
+// Cluster one material range, meshlets keep the range boundaries
+static void	buildRangeMeshlets(const std::vector<Vec3>& positions, const std::vector<uint>& indices, const MaterialRange& range,
+				std::vector<uint>& lastMeshlet, std::vector<Meshlet>& meshlets)
+{
+	Meshlet current = {};
+	current.firstIndex = range.firstIndex;
+	current.material = range.material;
+	uint end = range.firstIndex + range.indexCount;
+
+	for (uint i = range.firstIndex; i + 2 < end; i += 3)
+	{
+		uint meshletId = static_cast<uint>(meshlets.size());
+		uint newVertices = countNewVertices(indices, i, lastMeshlet, meshletId);
+
+		if (current.indexCount / 3 >= MESHLET_MAX_TRIANGLES || current.vertexCount + newVertices > MESHLET_MAX_VERTICES)
+		{
+			computeMeshletBounds(positions, indices, current);
+			meshlets.push_back(current);
+			current = {};
+			current.firstIndex = i;
+			current.material = range.material;
+			meshletId++;
+			newVertices = countNewVertices(indices, i, lastMeshlet, meshletId);
+		}
+
+		for (uint k = 0; k < 3; k++)
+			lastMeshlet[indices[i + k]] = meshletId;
+		current.vertexCount += newVertices;
+		current.indexCount += 3;
+	}
+
+	if (current.indexCount > 0)
+	{
+		computeMeshletBounds(positions, indices, current);
+		meshlets.push_back(current);
+	}
+}
+
+// Without ranges the whole index buffer uses the default material
+void	buildMeshlets(const std::vector<Vec3>& positions, const std::vector<uint>& indices, const std::vector<MaterialRange>& ranges,
+			std::vector<Meshlet>& meshlets)
+{
+	TRACE_SCOPE("buildMeshlets");
+	meshlets.clear();
+	meshlets.reserve(indices.size() / (3 * MESHLET_MAX_TRIANGLES / 2) + ranges.size() + 1);
+
+	// lastMeshlet[v] is the id of the last meshlet that referenced vertex v
+	std::vector<uint> lastMeshlet(positions.size(), UINT_MAX);
+
+	if (ranges.empty())
+		buildRangeMeshlets(positions, indices, { 0, 0, static_cast<uint>(indices.size()) }, lastMeshlet, meshlets);
+	for (const MaterialRange& range : ranges)
+		buildRangeMeshlets(positions, indices, range, lastMeshlet, meshlets);
+}
+
+// Neighbouring visible meshlets are contiguous in the index buffer and share one command,
+// baseInstance carries the material to the instanced material attribute
+static void	appendCommand(std::vector<DrawElementsIndirectCommand>& commands, const DrawElementsIndirectCommand& command)
+{
+	if (!commands.empty() && commands.back().firstIndex + commands.back().count == command.firstIndex
+		&& commands.back().baseInstance == command.baseInstance)
+		commands.back().count += command.count;
+	else
+		commands.push_back(command);
+}
+
+static void	cullRange(const Meshlet* meshlets, size_t count, const Mat4& model, const Frustum& frustum, const Vec3& cameraPos,
+			bool frustumCulling, bool backfaceCulling, std::vector<DrawElementsIndirectCommand>& commands, MeshletCullStats& stats)
+{
+	float scale = model.maxScale();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		stats.submittedTriangles += meshlet.indexCount / 3;
+
+		Vec3 center = model.transformPoint(meshlet.center);
+		float radius = meshlet.radius * scale;
+
+		if (frustumCulling && !frustum.intersectsSphere(center, radius))
+		{
+			stats.frustumCulled++;
+			continue;
+		}
+
+		if (backfaceCulling && meshlet.coneCutoff < 1.0f)
+		{
+			Vec3 axis = Vec3::normalize(model.transformVector(meshlet.coneAxis));
+			Vec3 toCenter = center - cameraPos;
+			if (Vec3::dot(toCenter, axis) >= meshlet.coneCutoff * Vec3::length(toCenter) + radius)
+			{
+				stats.backfaceCulled++;
+				continue;
+			}
+		}
+
+		stats.visibleMeshlets++;
+		stats.renderedTriangles += meshlet.indexCount / 3;
+		appendCommand(commands, { meshlet.indexCount, 1, meshlet.firstIndex, 0, meshlet.material });
+	}
+}
+
+// Large meshes are culled in chunks on the job system, the chunk results are joined in order so
+// the commands are the same as a serial pass
+void	cullMeshlets(const std::vector<Meshlet>& meshlets, const Mat4& model, const Mat4& viewProjection, const Vec3& cameraPos,
+			bool frustumCulling, bool backfaceCulling, std::vector<DrawElementsIndirectCommand>& commands, MeshletCullStats& stats)
+{
+	TRACE_SCOPE("cullMeshlets");
+	Frustum frustum = Frustum::fromMatrix(viewProjection);
+
+	commands.clear();
+	stats = {};
+	if (meshlets.size() <= MESHLET_CULL_GRAIN)
+	{
+		cullRange(meshlets.data(), meshlets.size(), model, frustum, cameraPos, frustumCulling, backfaceCulling, commands, stats);
+		return;
+	}
+
+	size_t chunkCount = (meshlets.size() + MESHLET_CULL_GRAIN - 1) / MESHLET_CULL_GRAIN;
+	std::vector<std::vector<DrawElementsIndirectCommand>> chunkCommands(chunkCount);
+	std::vector<MeshletCullStats> chunkStats(chunkCount, MeshletCullStats());
+	jobSystem().parallelFor("cull meshlets", meshlets.size(), MESHLET_CULL_GRAIN, [&](size_t begin, size_t end) {
+		size_t chunk = begin / MESHLET_CULL_GRAIN;
+		cullRange(meshlets.data() + begin, end - begin, model, frustum, cameraPos, frustumCulling, backfaceCulling,
+			chunkCommands[chunk], chunkStats[chunk]);
+	});
+
+	for (size_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		for (const DrawElementsIndirectCommand& command : chunkCommands[chunk])
+			appendCommand(commands, command);
+		stats.submittedTriangles += chunkStats[chunk].submittedTriangles;
+		stats.renderedTriangles += chunkStats[chunk].renderedTriangles;
+		stats.visibleMeshlets += chunkStats[chunk].visibleMeshlets;
+		stats.frustumCulled += chunkStats[chunk].frustumCulled;
+		stats.backfaceCulled += chunkStats[chunk].backfaceCulled;
+	}
+}
@@ -1,4 +1,6 @@
 #include "../include/Scop.hpp"
+#include <algorithm>
+#include <cmath>
 
 Mat4::Mat4(const Mat3& mat3) {
 	for (int i = 0; i < 3; i++)
@@ -72,51 +74,75 @@ void	Scop::cameraMovement()
 	this->view = Mat4::lookAt(this->cameraPos, this->cameraTarget, this->cameraUp);
 }
 
+// One SIMULATION_STEP of object movement, keys are sampled once per step
 void Scop::objectMovement()
 {
-	Mat3 rotationMatrix3 = Mat3(this->model);
-	Mat3 invRotationMatrix = Mat3::transpose(rotationMatrix3);
+	Mat3 invRotationMatrix = Mat3(Mat4::rotateY(-this->rotationAngle));
+	float step = this->movementSpeed * SIMULATION_STEP;
 
 	Vec3 translationDelta(0.0f, 0.0f, 0.0f);
 
 	if (glfwGetKey(this->window, GLFW_KEY_W) == GLFW_PRESS)
-		translationDelta += movementSpeed * invRotationMatrix * Vec3(0.0f, 0.0f, -1.0f);
+		translationDelta += step * invRotationMatrix * Vec3(0.0f, 0.0f, -1.0f);
 	if (glfwGetKey(this->window, GLFW_KEY_S) == GLFW_PRESS)
-		translationDelta -= movementSpeed * invRotationMatrix * Vec3(0.0f, 0.0f, -1.0f);
+		translationDelta -= step * invRotationMatrix * Vec3(0.0f, 0.0f, -1.0f);
 	if (glfwGetKey(this->window, GLFW_KEY_A) == GLFW_PRESS)
-		translationDelta -= movementSpeed * invRotationMatrix * Vec3(1.0f, 0.0f, 0.0f);
+		translationDelta -= step * invRotationMatrix * Vec3(1.0f, 0.0f, 0.0f);
 	if (glfwGetKey(this->window, GLFW_KEY_D) == GLFW_PRESS)
-		translationDelta += movementSpeed * invRotationMatrix * Vec3(1.0f, 0.0f, 0.0f);
+		translationDelta += step * invRotationMatrix * Vec3(1.0f, 0.0f, 0.0f);
 	if (glfwGetKey(this->window, GLFW_KEY_Q) == GLFW_PRESS)
-		translationDelta += movementSpeed * Vec3(0.0f, 1.0f, 0.0f);
+		translationDelta += step * Vec3(0.0f, 1.0f, 0.0f);
 	if (glfwGetKey(this->window, GLFW_KEY_E) == GLFW_PRESS)
-		translationDelta -= movementSpeed * Vec3(0.0f, 1.0f, 0.0f);
+		translationDelta -= step * Vec3(0.0f, 1.0f, 0.0f);
 	if (glfwGetKey(this->window, GLFW_KEY_SPACE) == GLFW_PRESS)
 		translationDelta = -objectPosition;
 
+	this->previousObjectPosition = this->objectPosition;
+	this->previousRotationAngle = this->rotationAngle;
 	this->objectPosition += translationDelta;
-	this->rotationAngle = this->rotationSpeed * this->deltaTime;
+	this->rotationAngle += this->rotationSpeed * SIMULATION_STEP;
+	// Wrapped so the float keeps its precision over long runs, both ends of the interpolation move together
+	if (this->rotationAngle >= 2.0f * M_PI)
+	{
+		this->rotationAngle -= 2.0f * M_PI;
+		this->previousRotationAngle -= 2.0f * M_PI;
+	}
+}
+
+// Runs as many fixed steps as the elapsed time covers; the remainder becomes the interpolation factor
+void Scop::advanceSimulation()
+{
+	if (this->lockstep)
+		this->simulationAccumulator = SIMULATION_STEP;
+	else
+		this->simulationAccumulator = std::min(this->simulationAccumulator + this->deltaTime, MAX_SIMULATION_STEPS * SIMULATION_STEP);
+
+	while (this->simulationAccumulator >= SIMULATION_STEP)
+	{
+		this->objectMovement();
+		this->simulationAccumulator -= SIMULATION_STEP;
+	}
+	this->updateModelMatrix(static_cast<float>(this->simulationAccumulator / SIMULATION_STEP));
+}
+
+void Scop::updateModelMatrix(float alpha)
+{
+	Vec3 position = this->previousObjectPosition + (this->objectPosition - this->previousObjectPosition) * alpha;
+	float angle = this->previousRotationAngle + (this->rotationAngle - this->previousRotationAngle) * alpha;
 
-	Vec3 modelCenterOffset = this->calculateModelCenterOffset() - this->objectPosition;
+	Vec3 modelCenterOffset = this->renderStatus.modelCenterOffset - position;
 	Mat4 translationToOrigin = Mat4::translate(-modelCenterOffset);
 	Mat4 translationBack = Mat4::translate(modelCenterOffset);
-	Mat4 rotationMatrix4 = Mat4::rotateY(this->rotationAngle);
 
-	this->model = Mat4::translate(this->objectPosition) * translationBack * Mat4(rotationMatrix3) * rotationMatrix4 * translationToOrigin;
+	this->model = Mat4::translate(position) * translationBack * Mat4::rotateY(angle) * translationToOrigin;
 }
 
 Vec3 Scop::calculateModelCenterOffset()
 {
-	Vec3 min = Vec3(FLT_MAX, FLT_MAX, FLT_MAX);
-	Vec3 max = Vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
-
-	for (const Vec3& vertex : vertex_postitions)
-	{
-		min = Vec3::min(min, vertex);
-		max = Vec3::max(max, vertex);
-	}
+	if (this->mesh.boundsMin.x > this->mesh.boundsMax.x)
+		return Vec3(0.0f, 0.0f, 0.0f);
 
-	Vec3 center = (min + max) * 0.5f;
+	Vec3 center = (this->mesh.boundsMin + this->mesh.boundsMax) * 0.5f;
 
 	return -center;
 }
@@ -0,0 +1,425 @@
+#include "../include/ObjStream.hpp"
+#include "../include/Trace.hpp"
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+size_t	ObjVertexKeyHash::operator()(const ObjVertexKey& key) const
+{
+	// FNV-1a over the raw key
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&key);
+	size_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < sizeof(ObjVertexKey); i++)
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	return hash;
+}
+
+ObjStream::ObjStream(const char* filePathName, std::pmr::memory_resource* resource)
+	: file(filePathName, std::ios::in | std::ios::binary), line(resource), positions(resource), texcoords(resource), normals(resource),
+	  faceCorners(resource), polygon(resource), projected(resource), windowArena(ARENA_BLOCK_SIZE, trackedResource(MEMORY_PARSER_SCRATCH))
+{
+	if (!this->file.is_open())
+	{
+		std::cerr << "Error: could not open file" << std::endl;
+		throw std::runtime_error("Error: could not open file");
+	}
+
+	this->file.seekg(0, std::ios::end);
+	this->fileSize = static_cast<size_t>(this->file.tellg());
+	this->file.seekg(0, std::ios::beg);
+	this->bytesRead = 0;
+	this->finished = false;
+	this->triangleCount = 0;
+	this->expectedVertices = 0;
+	this->directory = directoryOf(filePathName);
+	this->materials.emplace_back();
+	this->currentMaterial = 0;
+}
+
+bool	ObjStream::done() const
+{
+	return this->finished;
+}
+
+float	ObjStream::progress() const
+{
+	return this->fileSize ? static_cast<float>(this->bytesRead) / this->fileSize : 1.0f;
+}
+
+void	ObjStream::reserve(const ObjCounts& counts, size_t vertices)
+{
+	this->positions.reserve(counts.positions);
+	this->texcoords.reserve(counts.texcoords);
+	this->normals.reserve(counts.normals);
+	this->expectedVertices = vertices;
+}
+
+const std::vector<Material>&	ObjStream::getMaterials() const
+{
+	return this->materials;
+}
+
+const ArenaStats&	ObjStream::getWindowStats() const
+{
+	return this->windowArena.getStats();
+}
+
+static const char*	skipSpaces(const char* cursor)
+{
+	while (*cursor == ' ' || *cursor == '\t')
+		cursor++;
+	return cursor;
+}
+
+static Vec3	parseVec3(const char* cursor)
+{
+	char* end;
+	Vec3 v;
+	v.x = std::strtof(cursor, &end);
+	v.y = std::strtof(end, &end);
+	v.z = std::strtof(end, &end);
+	return v;
+}
+
+// OBJ indices are 1-based, negative ones are relative to the end of the pool
+static uint	resolveIndex(long index, size_t poolSize)
+{
+	if (index > 0 && static_cast<size_t>(index) <= poolSize)
+		return static_cast<uint>(index - 1);
+	if (index < 0 && static_cast<size_t>(-index) <= poolSize)
+		return static_cast<uint>(poolSize + index);
+	return OBJ_NO_INDEX;
+}
+
+uint	ObjStream::emitVertex(const ObjVertexKey& key, Mesh& window)
+{
+	auto it = this->vertexToIndex->find(key);
+	if (it != this->vertexToIndex->end())
+		return it->second;
+
+	uint index = static_cast<uint>(window.positions.size());
+	window.positions.push_back(this->positions[key.position]);
+	window.texcoords.push_back(key.texcoord != OBJ_NO_INDEX ? this->texcoords[key.texcoord] : key.uv);
+	window.normals.push_back(key.normal != OBJ_NO_INDEX ? this->normals[key.normal] : key.flatNormal);
+	this->vertexToIndex->emplace(key, index);
+	return index;
+}
+
+// corners[i] = { position, texcoord, normal } pool indices
+void	ObjStream::emitTriangle(const uint corners[3][3], Mesh& window)
+{
+	// Same placeholder pattern as before for faces without uvs: two triangles make a unit quad
+	static const TextureCoord placeholderUvs[2][3] = {
+		{ { 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } },
+		{ { 0.0f, 0.0f }, { 1.0f, 1.0f }, { 1.0f, 0.0f } },
+	};
+
+	Vec3 flatNormal;
+	if (corners[0][2] == OBJ_NO_INDEX || corners[1][2] == OBJ_NO_INDEX || corners[2][2] == OBJ_NO_INDEX)
+	{
+		const Vec3& v0 = this->positions[corners[0][0]];
+		flatNormal = Vec3::normalize(Vec3::cross(this->positions[corners[1][0]] - v0, this->positions[corners[2][0]] - v0));
+	}
+
+	for (int i = 0; i < 3; i++)
+	{
+		ObjVertexKey key = {};
+		key.position = corners[i][0];
+		key.texcoord = corners[i][1];
+		key.normal = corners[i][2];
+		if (key.texcoord == OBJ_NO_INDEX)
+			key.uv = placeholderUvs[this->triangleCount & 1][i];
+		if (key.normal == OBJ_NO_INDEX)
+			key.flatNormal = flatNormal;
+		window.indices.push_back(this->emitVertex(key, window));
+	}
+	this->triangleCount++;
+
+	// Faces are recorded as runs of the same material, groupByMaterial merges them
+	std::vector<MaterialRange>& runs = window.materialRanges;
+	if (runs.empty() || runs.back().material != this->currentMaterial)
+		runs.push_back({ this->currentMaterial, static_cast<uint>(window.indices.size() - 3), 0 });
+	runs.back().indexCount += 3;
+}
+
+void	ObjStream::emitCorners(uint a, uint b, uint c, Mesh& window)
+{
+	uint corners[3][3];
+	std::memcpy(corners[0], &this->faceCorners[a * 3], sizeof(corners[0]));
+	std::memcpy(corners[1], &this->faceCorners[b * 3], sizeof(corners[1]));
+	std::memcpy(corners[2], &this->faceCorners[c * 3], sizeof(corners[2]));
+	this->emitTriangle(corners, window);
+}
+
+// Newell normal of the face, not normalized
+Vec3	ObjStream::faceNormal(uint cornerCount) const
+{
+	Vec3 normal;
+	for (uint i = 0; i < cornerCount; i++)
+	{
+		const Vec3& a = this->positions[this->faceCorners[i * 3]];
+		const Vec3& b = this->positions[this->faceCorners[((i + 1) % cornerCount) * 3]];
+		normal.x += (a.y - b.y) * (a.z + b.z);
+		normal.y += (a.z - b.z) * (a.x + b.x);
+		normal.z += (a.x - b.x) * (a.y + b.y);
+	}
+	return normal;
+}
+
+bool	ObjStream::isConvex(uint cornerCount, const Vec3& normal) const
+{
+	for (uint i = 0; i < cornerCount; i++)
+	{
+		const Vec3& prev = this->positions[this->faceCorners[((i + cornerCount - 1) % cornerCount) * 3]];
+		const Vec3& cur = this->positions[this->faceCorners[i * 3]];
+		const Vec3& next = this->positions[this->faceCorners[((i + 1) % cornerCount) * 3]];
+		if (Vec3::dot(Vec3::cross(cur - prev, next - cur), normal) < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+static float	cross2d(const float a[2], const float b[2], const float c[2])
+{
+	return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+// Ear clipping in the plane that drops the dominant axis of the normal, O(n^2)
+uint	ObjStream::clipEars(uint cornerCount, const Vec3& normal, Mesh& window)
+{
+	Vec3 n = Vec3(std::fabs(normal.x), std::fabs(normal.y), std::fabs(normal.z));
+	int u = 0, v = 1;
+	if (n.x >= n.y && n.x >= n.z)
+		u = 1, v = 2;
+	else if (n.y >= n.z)
+		u = 2, v = 0;
+	float sign = (u == 1 ? normal.x : (u == 2 ? normal.y : normal.z)) < 0.0f ? -1.0f : 1.0f;
+
+	this->projected.resize(cornerCount * 2);
+	this->polygon.resize(cornerCount);
+	for (uint i = 0; i < cornerCount; i++)
+	{
+		const Vec3& p = this->positions[this->faceCorners[i * 3]];
+		const float axes[3] = { p.x, p.y, p.z };
+		this->projected[i * 2] = axes[u] * sign;
+		this->projected[i * 2 + 1] = axes[v];
+		this->polygon[i] = i;
+	}
+
+	uint triangles = 0;
+	uint remaining = cornerCount;
+	uint i = 0;
+	uint misses = 0;
+	while (remaining > 3 && misses < remaining)
+	{
+		uint prev = this->polygon[(i + remaining - 1) % remaining];
+		uint cur = this->polygon[i % remaining];
+		uint next = this->polygon[(i + 1) % remaining];
+		const float* a = &this->projected[prev * 2];
+		const float* b = &this->projected[cur * 2];
+		const float* c = &this->projected[next * 2];
+
+		bool ear = cross2d(a, b, c) > 0.0f;
+		for (uint k = 0; ear && k < remaining; k++)
+		{
+			uint other = this->polygon[k];
+			if (other == prev || other == cur || other == next)
+				continue;
+			const float* p = &this->projected[other * 2];
+			ear = !(cross2d(a, b, p) >= 0.0f && cross2d(b, c, p) >= 0.0f && cross2d(c, a, p) >= 0.0f);
+		}
+
+		if (ear)
+		{
+			this->emitCorners(prev, cur, next, window);
+			triangles++;
+			this->polygon.erase(this->polygon.begin() + (i % remaining));
+			remaining--;
+			misses = 0;
+		}
+		else
+		{
+			i++;
+			misses++;
+		}
+		i %= remaining;
+	}
+
+	// Whatever is left (the last triangle, or a degenerate/self-intersecting rest) is fanned
+	for (uint k = 2; k < remaining; k++, triangles++)
+		this->emitCorners(this->polygon[0], this->polygon[k - 1], this->polygon[k], window);
+	return triangles;
+}
+
+// Convex polygons are fanned around their first corner, concave ones are ear clipped.
+// The corner scratch is reused across faces, returns the number of triangles
+uint	ObjStream::parseFace(const char* cursor, Mesh& window)
+{
+	uint cornerCount = 0;
+
+	this->faceCorners.clear();
+	while (*(cursor = skipSpaces(cursor)) && *cursor != '\r' && *cursor != '#')
+	{
+		char* end;
+		uint corner[3] = { OBJ_NO_INDEX, OBJ_NO_INDEX, OBJ_NO_INDEX };
+
+		corner[0] = resolveIndex(std::strtol(cursor, &end, 10), this->positions.size());
+		if (end == cursor)
+			break;
+		cursor = end;
+		if (*cursor == '/')
+		{
+			cursor++;
+			if (*cursor != '/')
+			{
+				corner[1] = resolveIndex(std::strtol(cursor, &end, 10), this->texcoords.size());
+				cursor = end;
+			}
+			if (*cursor == '/')
+			{
+				cursor++;
+				corner[2] = resolveIndex(std::strtol(cursor, &end, 10), this->normals.size());
+				cursor = end;
+			}
+		}
+		while (*cursor && *cursor != ' ' && *cursor != '\t')
+			cursor++;
+
+		if (corner[0] == OBJ_NO_INDEX)
+			continue;
+		this->faceCorners.insert(this->faceCorners.end(), corner, corner + 3);
+		cornerCount++;
+	}
+
+	if (cornerCount < 3)
+		return 0;
+	if (cornerCount > 3)
+	{
+		Vec3 normal = this->faceNormal(cornerCount);
+		if (!this->isConvex(cornerCount, normal))
+			return this->clipEars(cornerCount, normal, window);
+	}
+	for (uint i = 2; i < cornerCount; i++)
+		this->emitCorners(0, i - 1, i, window);
+	return cornerCount - 2;
+}
+
+// mtllib loads libraries relative to the OBJ file, usemtl selects by name (unknown names use the default)
+void	ObjStream::parseMaterialLine(const char* cursor)
+{
+	std::string arguments(skipSpaces(cursor + 6));
+	while (!arguments.empty() && (arguments.back() == '\r' || arguments.back() == ' ' || arguments.back() == '\t'))
+		arguments.pop_back();
+
+	if (std::strncmp(cursor, "usemtl", 6) == 0)
+	{
+		this->currentMaterial = 0;
+		for (uint i = 1; i < this->materials.size(); i++)
+			if (this->materials[i].name == arguments)
+				this->currentMaterial = i;
+		return;
+	}
+
+	size_t start = 0;
+	while (start < arguments.size())
+	{
+		size_t end = arguments.find_first_of(" \t", start);
+		if (end == std::string::npos)
+			end = arguments.size();
+		if (end > start)
+			loadMtlFile((this->directory + arguments.substr(start, end - start)).c_str(), this->materials);
+		start = end + 1;
+	}
+}
+
+// Stable counting sort of the window's triangles by material when a material shows up in several runs
+void	ObjStream::groupByMaterial(Mesh& window)
+{
+	TRACE_SCOPE("groupByMaterial");
+	std::vector<MaterialRange>& runs = window.materialRanges;
+	std::pmr::vector<uint> firstIndex(this->materials.size(), UINT_MAX, this->faceCorners.get_allocator());
+	bool split = false;
+
+	for (const MaterialRange& run : runs)
+	{
+		split |= firstIndex[run.material] != UINT_MAX;
+		firstIndex[run.material] = 0;
+	}
+	if (!split)
+		return;
+
+	std::pmr::vector<uint> counts(this->materials.size(), 0, this->faceCorners.get_allocator());
+	for (const MaterialRange& run : runs)
+		counts[run.material] += run.indexCount;
+
+	std::vector<MaterialRange> grouped;
+	uint offset = 0;
+	for (uint material = 0; material < counts.size(); material++)
+	{
+		if (counts[material] == 0)
+			continue;
+		firstIndex[material] = offset;
+		grouped.push_back({ material, offset, counts[material] });
+		offset += counts[material];
+	}
+
+	std::vector<uint> indices(window.indices.size());
+	for (const MaterialRange& run : runs)
+	{
+		std::copy(window.indices.begin() + run.firstIndex, window.indices.begin() + run.firstIndex + run.indexCount,
+			indices.begin() + firstIndex[run.material]);
+		firstIndex[run.material] += run.indexCount;
+	}
+	window.indices.swap(indices);
+	runs.swap(grouped);
+}
+
+// Read faces until maxTriangles are produced, window indices are local to the window
+uint	ObjStream::readWindow(Mesh& window, uint maxTriangles)
+{
+	TRACE_SCOPE("parse and dedup window");
+	window.clear();
+	this->vertexToIndex.reset();
+	this->windowArena.reset();
+	this->vertexToIndex.emplace(&this->windowArena);
+	if (this->expectedVertices)
+		this->vertexToIndex->reserve(std::min<size_t>(this->expectedVertices, static_cast<size_t>(maxTriangles) * 3));
+
+	uint triangles = 0;
+	while (triangles < maxTriangles && std::getline(this->file, this->line))
+	{
+		this->bytesRead += this->line.size() + 1;
+
+		const char* cursor = skipSpaces(this->line.c_str());
+		if (cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t'))
+			this->positions.push_back(parseVec3(cursor + 2));
+		else if (cursor[0] == 'v' && cursor[1] == 't' && (cursor[2] == ' ' || cursor[2] == '\t'))
+		{
+			char* end;
+			TextureCoord uv;
+			uv.u = std::strtof(cursor + 3, &end);
+			uv.v = std::strtof(end, &end);
+			this->texcoords.push_back(uv);
+		}
+		else if (cursor[0] == 'v' && cursor[1] == 'n' && (cursor[2] == ' ' || cursor[2] == '\t'))
+			this->normals.push_back(parseVec3(cursor + 3));
+		else if (cursor[0] == 'f' && (cursor[1] == ' ' || cursor[1] == '\t'))
+			triangles += this->parseFace(cursor + 2, window);
+		else if ((std::strncmp(cursor, "usemtl", 6) == 0 || std::strncmp(cursor, "mtllib", 6) == 0) && (cursor[6] == ' ' || cursor[6] == '\t'))
+			this->parseMaterialLine(cursor);
+	}
+
+	if (triangles < maxTriangles)
+	{
+		this->finished = true;
+		this->bytesRead = this->fileSize;
+		this->file.close();
+	}
+	this->groupByMaterial(window);
+	window.materials = this->materials;
+	window.computeBounds();
+	return triangles;
+}
@@ -0,0 +1,178 @@
+#include "../include/RenderTarget.hpp"
+#include "../include/MemoryStats.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+RenderTarget::RenderTarget(bool srgb)
+{
+	this->srgb = srgb;
+	GLint textureSize = 0, renderbufferSize = 0, maxSamples = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &textureSize);
+	glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &renderbufferSize);
+	glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+	this->maxSize = std::min(textureSize, renderbufferSize);
+	this->maxSamples = std::max(1, std::min(maxSamples, RENDER_MAX_SAMPLES));
+	this->width = 0;
+	this->height = 0;
+	this->samples = 0;
+	this->multisampleFramebuffer = 0;
+	this->colorRenderbuffer = 0;
+	this->depthRenderbuffer = 0;
+	this->framebuffer = 0;
+	this->colorTexture = 0;
+	this->depthTexture = 0;
+}
+
+RenderTarget::~RenderTarget()
+{
+	this->destroy();
+}
+
+void	RenderTarget::destroy()
+{
+	glDeleteFramebuffers(1, &this->multisampleFramebuffer);
+	glDeleteRenderbuffers(1, &this->colorRenderbuffer);
+	glDeleteRenderbuffers(1, &this->depthRenderbuffer);
+	glDeleteFramebuffers(1, &this->framebuffer);
+	glDeleteTextures(1, &this->colorTexture);
+	glDeleteTextures(1, &this->depthTexture);
+	untrackGpuResource(GPU_RENDERBUFFER, this->colorRenderbuffer);
+	untrackGpuResource(GPU_RENDERBUFFER, this->depthRenderbuffer);
+	untrackGpuResource(GPU_TEXTURE, this->colorTexture);
+	untrackGpuResource(GPU_TEXTURE, this->depthTexture);
+	this->multisampleFramebuffer = 0;
+	this->colorRenderbuffer = 0;
+	this->depthRenderbuffer = 0;
+	this->framebuffer = 0;
+	this->colorTexture = 0;
+	this->depthTexture = 0;
+}
+
+static void	checkFramebuffer(GLenum target)
+{
+	if (glCheckFramebufferStatus(target) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cerr << "Error: incomplete offscreen framebuffer" << std::endl;
+		throw std::runtime_error("Error: incomplete offscreen framebuffer");
+	}
+}
+
+static uint	createTexture(GLenum internalFormat, int width, int height)
+{
+	uint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	trackGpuResource(GPU_TEXTURE, texture, "render target", textureStorageBytes(internalFormat, width, height, 1, 1));
+	return texture;
+}
+
+static uint	createRenderbuffer(GLenum internalFormat, int width, int height, int samples)
+{
+	uint renderbuffer;
+	glGenRenderbuffers(1, &renderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+	glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, internalFormat, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	trackGpuResource(GPU_RENDERBUFFER, renderbuffer, "render target", textureStorageBytes(internalFormat, width, height, 1, 1) * samples);
+	return renderbuffer;
+}
+
+// Both depth attachments are DEPTH_COMPONENT32F, a depth blit needs matching formats
+void	RenderTarget::create()
+{
+	GLenum colorFormat = this->srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+
+	this->colorTexture = createTexture(colorFormat, this->width, this->height);
+	this->depthTexture = createTexture(GL_DEPTH_COMPONENT32F, this->width, this->height);
+	glGenFramebuffers(1, &this->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->colorTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, this->depthTexture, 0);
+	checkFramebuffer(GL_FRAMEBUFFER);
+
+	if (this->samples > 1)
+	{
+		this->colorRenderbuffer = createRenderbuffer(colorFormat, this->width, this->height, this->samples);
+		this->depthRenderbuffer = createRenderbuffer(GL_DEPTH_COMPONENT32F, this->width, this->height, this->samples);
+		glGenFramebuffers(1, &this->multisampleFramebuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, this->multisampleFramebuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->colorRenderbuffer);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->depthRenderbuffer);
+		checkFramebuffer(GL_FRAMEBUFFER);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void	RenderTarget::bind(int windowWidth, int windowHeight, float scale, int samples)
+{
+	scale = std::min(std::max(scale, RENDER_SCALE_MIN), RENDER_SCALE_MAX);
+	int width = std::min(std::max(static_cast<int>(std::lround(windowWidth * scale)), 1), this->maxSize);
+	int height = std::min(std::max(static_cast<int>(std::lround(windowHeight * scale)), 1), this->maxSize);
+	samples = std::min(std::max(samples, 1), this->maxSamples);
+
+	if (width != this->width || height != this->height || samples != this->samples)
+	{
+		this->destroy();
+		this->width = width;
+		this->height = height;
+		this->samples = samples;
+		this->create();
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, this->samples > 1 ? this->multisampleFramebuffer : this->framebuffer);
+	glViewport(0, 0, this->width, this->height);
+}
+
+void	RenderTarget::resolve()
+{
+	if (this->samples > 1)
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, this->multisampleFramebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, this->framebuffer);
+		glBlitFramebuffer(0, 0, this->width, this->height, 0, 0, this->width, this->height,
+			GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, this->framebuffer);
+}
+
+// Linear filtering works on decoded values when both sides are sRGB and the conversion is enabled
+void	RenderTarget::present(int windowWidth, int windowHeight)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, this->framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	if (this->srgb)
+		glEnable(GL_FRAMEBUFFER_SRGB);
+	glBlitFramebuffer(0, 0, this->width, this->height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT,
+		this->width == windowWidth && this->height == windowHeight ? GL_NEAREST : GL_LINEAR);
+	glDisable(GL_FRAMEBUFFER_SRGB);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, windowWidth, windowHeight);
+}
+
+int	RenderTarget::getWidth() const
+{
+	return this->width;
+}
+
+int	RenderTarget::getHeight() const
+{
+	return this->height;
+}
+
+int	RenderTarget::getSamples() const
+{
+	return this->samples;
+}
+
+int	RenderTarget::getMaxSamples() const
+{
+	return this->maxSamples;
+}
@@ -1,7 +1,24 @@
 #include "../include/Scop.hpp"
+#include "../include/Shader.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+
+#define SHADER_CACHE_MAGIC	0x42504353u // "SCPB"
+
+// Stored in front of the driver's binary, every byte is a field so the same program writes the same file
+struct ProgramBinaryHeader
+{
+	uint32_t	magic;
+	uint32_t	format;
+	uint64_t	hash;
+	uint32_t	length;
+	uint32_t	reserved; // always 0, spells out the tail padding
+};
+static_assert(sizeof(ProgramBinaryHeader) == 24, "the cache header has no padding");
 
 // Function to load a shader source file
-static std::string	loadShaderSource(const char* filename)
+std::string	loadShaderSource(const char* filename)
 {
 	std::ifstream	file(filename);
 	if (!file.is_open())
@@ -19,65 +36,276 @@ static std::string	loadShaderSource(const char* filename)
 	return source;
 }
 
-// Function to compile a shader
+std::string	injectDefines(const std::string& source, const std::vector<std::string>& defines)
+{
+	size_t position = source.compare(0, 8, "#version") == 0 ? source.find('\n') + 1 : 0;
+	std::string lines;
+	for (const std::string& define : defines)
+		lines += "#define " + define + "\n";
+	return source.substr(0, position) + lines + source.substr(position);
+}
+
+// Function to start compiling a shader, the status is read in finishProgram
 static uint	compileShader(GLenum shaderType, const char* source)
 {
 	uint shader = glCreateShader(shaderType);
 	glShaderSource(shader, 1, &source, NULL);
 	glCompileShader(shader);
+	return shader;
+}
 
+static bool	checkShader(uint shader, PendingProgram& pending)
+{
 	GLint success;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
 		GLchar infoLog[512];
 		glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
-		std::cerr << "Failed to compile shader:\n" << infoLog << std::endl;
+		std::cerr << "Failed to compile shader " << pending.name << ":\n" << infoLog << std::endl;
+		pending.log += infoLog;
+	}
+	return success;
+}
+
+// FNV-1a over the sources and the driver strings, any driver update invalidates the cache
+static uint64_t	programHash(const std::vector<ShaderStage>& stages)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	auto mix = [&hash](const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++)
+			hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+	};
+
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION })
+	{
+		const char* value = reinterpret_cast<const char*>(glGetString(name));
+		if (value)
+			mix(value, std::strlen(value) + 1);
+	}
+	for (const ShaderStage& stage : stages)
+	{
+		mix(&stage.type, sizeof(stage.type));
+		mix(stage.source.data(), stage.source.size() + 1);
+	}
+	return hash;
+}
+
+static std::string	programCachePath(uint64_t hash)
+{
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+	return std::string(SHADER_CACHE_DIRECTORY) + "/" + name;
+}
+
+// Some drivers expose the extension without any binary format, nothing is cached then
+static bool	programBinarySupported()
+{
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+// Returns 0 when there is no cached binary, it is truncated or the driver refuses it.
+// The length comes from disk, it has to match the file before anything is allocated.
+static uint	loadProgramBinary(uint64_t hash)
+{
+	std::string path = programCachePath(hash);
+	std::error_code error;
+	uintmax_t fileSize = std::filesystem::file_size(path, error);
+	if (error)
+		return 0;
+
+	std::ifstream file(path, std::ios::binary);
+	ProgramBinaryHeader header;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != SHADER_CACHE_MAGIC || header.hash != hash)
+		return 0;
+	if (header.length == 0 || header.length != fileSize - sizeof(header))
+	{
+		std::cerr << "Warning: discarding corrupt shader cache " << path << std::endl;
 		return 0;
 	}
+	std::vector<char> binary(header.length);
+	if (!file.read(binary.data(), binary.size()))
+		return 0;
 
-	return shader;
+	uint program = glCreateProgram();
+	glProgramBinary(program, header.format, binary.data(), header.length);
+	GLint success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
 }
 
-// Function to create a shader program
-static uint	createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource)
+// Written to a temporary file first so a crash never leaves a truncated binary behind
+static void	saveProgramBinary(uint program, uint64_t hash)
 {
-	uint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
-	uint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	ProgramBinaryHeader header = { SHADER_CACHE_MAGIC, 0, hash, static_cast<uint32_t>(length), 0 };
+	std::vector<char> binary(length);
+	GLenum format;
+	glGetProgramBinary(program, length, nullptr, &format, binary.data());
+	header.format = format;
+
+	std::error_code error;
+	std::filesystem::create_directories(SHADER_CACHE_DIRECTORY, error);
+	std::string path = programCachePath(hash);
+	std::string temporary = path + ".tmp";
+	std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+	if (!file.write(reinterpret_cast<const char*>(&header), sizeof(header)) || !file.write(binary.data(), binary.size()))
+	{
+		std::cerr << "Warning: could not write shader cache " << temporary << std::endl;
+		return;
+	}
+	file.close();
+	std::filesystem::rename(temporary, path, error);
+	if (error)
+		std::cerr << "Warning: could not write shader cache " << path << std::endl;
+}
 
-	uint shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glLinkProgram(shaderProgram);
+static bool	parallelShaderCompile()
+{
+	return GLAD_GL_KHR_parallel_shader_compile || GLAD_GL_ARB_parallel_shader_compile;
+}
+
+// Let the driver use as many compiler threads as it wants
+void	enableParallelShaderCompile()
+{
+	if (GLAD_GL_KHR_parallel_shader_compile)
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+	else if (GLAD_GL_ARB_parallel_shader_compile)
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+}
+
+// Nothing here reads a status back, so nothing waits for the compiler
+void	beginProgram(const std::vector<ShaderStage>& stages, const char* name, PendingProgram& pending)
+{
+	TRACE_SCOPE("beginProgram");
+	pending.name = name;
+	pending.log.clear();
+	pending.shaders.clear();
+	pending.cacheable = programBinarySupported();
+	pending.hash = pending.cacheable ? programHash(stages) : 0;
+	pending.program = pending.cacheable ? loadProgramBinary(pending.hash) : 0;
+	if (pending.program)
+		return;
+
+	pending.program = glCreateProgram();
+	for (const ShaderStage& stage : stages)
+	{
+		uint shader = compileShader(stage.type, stage.source.c_str());
+		glAttachShader(pending.program, shader);
+		pending.shaders.push_back(shader);
+	}
+	if (pending.cacheable)
+		glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(pending.program);
+}
+
+bool	isProgramReady(const PendingProgram& pending)
+{
+	if (pending.shaders.empty() || !parallelShaderCompile())
+		return true;
+	GLint complete = GL_TRUE;
+	glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete;
+}
+
+uint	finishProgram(PendingProgram& pending)
+{
+	TRACE_SCOPE("finishProgram");
+	uint program = pending.program;
+	pending.program = 0;
+	if (pending.shaders.empty())
+		return program;
+
+	bool compiled = true;
+	for (uint shader : pending.shaders)
+		compiled = checkShader(shader, pending) && compiled;
+	for (uint shader : pending.shaders)
+		glDeleteShader(shader);
+	pending.shaders.clear();
 
 	GLint success;
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
 	if (!success)
 	{
-		GLchar infoLog[512];
-		glGetProgramInfoLog(shaderProgram, sizeof(infoLog), NULL, infoLog);
-		std::cerr << "Failed to link shader program:\n" << infoLog << std::endl;
+		if (compiled)
+		{
+			GLchar infoLog[512];
+			glGetProgramInfoLog(program, sizeof(infoLog), NULL, infoLog);
+			std::cerr << "Failed to link program " << pending.name << ":\n" << infoLog << std::endl;
+			pending.log += infoLog;
+		}
+		glDeleteProgram(program);
 		return 0;
 	}
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	if (pending.cacheable)
+		saveProgramBinary(program, pending.hash);
+	return program;
+}
+
+uint	buildProgram(const std::vector<ShaderStage>& stages, const char* name)
+{
+	PendingProgram pending;
+	beginProgram(stages, name, pending);
+	return finishProgram(pending);
+}
+
+uint	loadComputeProgram(const char* filename, std::string* log)
+{
+	std::string source = loadShaderSource(filename);
+	if (source.empty())
+	{
+		if (log)
+			*log = std::string("Could not read ") + filename;
+		return 0;
+	}
 
-	return shaderProgram;
+	PendingProgram pending;
+	beginProgram({ { GL_COMPUTE_SHADER, source } }, filename, pending);
+	uint program = finishProgram(pending);
+	if (log)
+		*log = pending.log;
+	return program;
 }
 
 void	Scop::loadShader()
 {
-	std::string vertexShaderSource = loadShaderSource("./ressources/shaders/vertex.glsl");
-	std::string fragmentShaderSource = loadShaderSource("./ressources/shaders/fragment.glsl");
+	this->shaderVariants = std::make_unique<ShaderVariants>("./ressources/shaders/vertex.glsl", "./ressources/shaders/fragment.glsl");
+	this->shaderProgram = 0;
+	this->shaderWatcher = std::make_unique<FileWatcher>("./ressources/shaders");
+}
 
-	this->shaderProgram = createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+// Polled on the main thread, the rebuild is posted to the render thread. Scene shaders build in the
+// background, the compute ones are small enough to rebuild on the spot; either way a broken edit
+// keeps the previous program.
+void	Scop::reloadShaders()
+{
+	if (!this->shaderWatcher->poll(this->changedShaders))
+		return;
 
-	if (shaderProgram == 0)
+	bool scene = false, compute = false;
+	for (const std::string& name : this->changedShaders)
 	{
-		std::cerr << "Error: could not create shader program" << std::endl;
-		throw std::runtime_error("Error: could not create shader program");
+		scene = scene || name == "vertex.glsl" || name == "fragment.glsl";
+		compute = compute || name == "cull.comp" || name == "hiz.comp";
 	}
-
-	glUseProgram(this->shaderProgram);
+	this->pendingCommands.push_back([this, scene, compute]() {
+		if (scene)
+			this->shaderVariants->reload();
+		if (compute && this->gpuCulling && this->gpuCulling->reloadPrograms(this->computeShaderError))
+			this->computeShaderError.clear();
+	});
+	this->requestRedraw();
 }
@@ -0,0 +1,173 @@
+#include "../include/ShaderVariants.hpp"
+#include "../include/MaterialTextures.hpp"
+#include <iostream>
+#include <stdexcept>
+
+// Sampler units never change, they are set once per program
+void	setupSceneProgram(uint program)
+{
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "textureSampler"), 0);
+	glUniform1i(glGetUniformLocation(program, "materialTextures"), MATERIAL_TEXTURE_UNIT);
+	glUseProgram(0);
+}
+
+// The generic program is built right away, a frame is always drawable
+ShaderVariants::ShaderVariants(const char* vertexPath, const char* fragmentPath) : vertexPath(vertexPath), fragmentPath(fragmentPath)
+{
+	this->vertexSource = loadShaderSource(vertexPath);
+	this->fragmentSource = loadShaderSource(fragmentPath);
+	this->reloading = false;
+	for (Variant& variant : this->variants)
+	{
+		variant.program = 0;
+		variant.compiling = false;
+		variant.failed = false;
+	}
+
+	enableParallelShaderCompile();
+	this->generic = buildProgram({ { GL_VERTEX_SHADER, this->vertexSource }, { GL_FRAGMENT_SHADER, this->fragmentSource } }, "scene");
+	if (this->generic == 0)
+	{
+		std::cerr << "Error: could not create shader program" << std::endl;
+		throw std::runtime_error("Error: could not create shader program");
+	}
+	setupSceneProgram(this->generic);
+}
+
+ShaderVariants::~ShaderVariants()
+{
+	this->clearVariants();
+	if (this->reloading)
+		glDeleteProgram(finishProgram(this->reloadPending));
+	glDeleteProgram(this->generic);
+}
+
+void	ShaderVariants::clearVariants()
+{
+	for (Variant& variant : this->variants)
+	{
+		if (variant.compiling)
+			glDeleteProgram(finishProgram(variant.pending));
+		glDeleteProgram(variant.program);
+		variant.program = 0;
+		variant.compiling = false;
+		variant.failed = false;
+	}
+}
+
+// A newer edit replaces a build still in flight
+void	ShaderVariants::reload()
+{
+	if (this->reloading)
+		glDeleteProgram(finishProgram(this->reloadPending));
+	this->reloading = false;
+
+	this->reloadVertexSource = loadShaderSource(this->vertexPath.c_str());
+	this->reloadFragmentSource = loadShaderSource(this->fragmentPath.c_str());
+	if (this->reloadVertexSource.empty() || this->reloadFragmentSource.empty())
+	{
+		this->error = "Could not read " + this->vertexPath + " or " + this->fragmentPath;
+		return;
+	}
+	beginProgram({ { GL_VERTEX_SHADER, this->reloadVertexSource }, { GL_FRAGMENT_SHADER, this->reloadFragmentSource } },
+		"scene", this->reloadPending);
+	this->reloading = true;
+}
+
+// Variants of the old sources are dropped, they are rebuilt from the new ones when next used
+void	ShaderVariants::finishReload()
+{
+	uint program = finishProgram(this->reloadPending);
+	this->reloading = false;
+	if (program == 0)
+	{
+		this->error = this->reloadPending.log;
+		return;
+	}
+
+	this->clearVariants();
+	glDeleteProgram(this->generic);
+	this->generic = program;
+	setupSceneProgram(this->generic);
+	this->vertexSource.swap(this->reloadVertexSource);
+	this->fragmentSource.swap(this->reloadFragmentSource);
+	this->error.clear();
+}
+
+bool	ShaderVariants::isReloading() const
+{
+	return this->reloading;
+}
+
+bool	ShaderVariants::isCompiling() const
+{
+	for (const Variant& variant : this->variants)
+		if (variant.compiling)
+			return true;
+	return this->reloading;
+}
+
+const std::string&	ShaderVariants::getError() const
+{
+	return this->error;
+}
+
+void	ShaderVariants::begin(uint features)
+{
+	std::vector<std::string> defines = {
+		std::string("GRADIENT_ENABLED ") + (features & SHADER_GRADIENT ? "true" : "false"),
+		std::string("LIGHTING_ENABLED ") + (features & SHADER_LIGHTING ? "true" : "false"),
+		std::string("TEXTURE_ENABLED ") + (features & SHADER_TEXTURE ? "true" : "false"),
+	};
+	std::string name = "scene variant " + std::to_string(features);
+
+	Variant& variant = this->variants[features];
+	beginProgram({ { GL_VERTEX_SHADER, this->vertexSource }, { GL_FRAGMENT_SHADER, injectDefines(this->fragmentSource, defines) } },
+		name.c_str(), variant.pending);
+	variant.compiling = true;
+}
+
+// A variant that fails to build is not retried, the generic program keeps drawing it
+void	ShaderVariants::finish(Variant& variant)
+{
+	variant.program = finishProgram(variant.pending);
+	variant.compiling = false;
+	variant.failed = variant.program == 0;
+	if (variant.program)
+		setupSceneProgram(variant.program);
+	else
+		this->error = variant.pending.log;
+}
+
+// Called once per frame, picks up the programs the driver finished compiling
+void	ShaderVariants::update()
+{
+	if (this->reloading && isProgramReady(this->reloadPending))
+		this->finishReload();
+	for (Variant& variant : this->variants)
+		if (variant.compiling && isProgramReady(variant.pending))
+			this->finish(variant);
+}
+
+uint	ShaderVariants::get(uint features)
+{
+	features &= SHADER_FEATURE_MASK;
+	if (features & SHADER_GRADIENT)
+		features &= ~SHADER_TEXTURE;
+
+	Variant& variant = this->variants[features];
+	if (variant.program)
+		return variant.program;
+	if (!variant.compiling && !variant.failed)
+		this->begin(features);
+	return this->generic;
+}
+
+uint	ShaderVariants::getReadyCount() const
+{
+	uint count = 0;
+	for (const Variant& variant : this->variants)
+		count += variant.program != 0;
+	return count;
+}
@@ -0,0 +1,144 @@
+#include "../include/StreamBuffer.hpp"
+#include "../include/MemoryStats.hpp"
+#include <stdexcept>
+
+StreamBuffer::StreamBuffer(GLsizeiptr sectionSize)
+{
+	this->sectionSize = sectionSize;
+	this->section = 0;
+	this->head = 0;
+	this->stallCount = 0;
+	this->mapped = nullptr;
+	for (int i = 0; i < STREAM_BUFFER_SECTIONS; i++)
+		this->fences[i] = nullptr;
+
+	GLsizeiptr totalSize = sectionSize * STREAM_BUFFER_SECTIONS;
+	glGenBuffers(1, &this->buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+	if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_COPY_WRITE_BUFFER, totalSize, nullptr, flags);
+		this->mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags));
+		if (!this->mapped)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+			glDeleteBuffers(1, &this->buffer);
+			throw std::runtime_error("Error: could not map stream buffer");
+		}
+	}
+	else
+		glBufferData(GL_COPY_WRITE_BUFFER, totalSize, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	trackGpuResource(GPU_BUFFER, this->buffer, "stream buffer", totalSize);
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	for (int i = 0; i < STREAM_BUFFER_SECTIONS; i++)
+		if (this->fences[i])
+			glDeleteSync(this->fences[i]);
+
+	if (this->mapped)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &this->buffer);
+	untrackGpuResource(GPU_BUFFER, this->buffer);
+}
+
+// Fence what was written so far and move to the next section, waiting for the GPU if it still reads it
+void	StreamBuffer::nextSection()
+{
+	if (this->fences[this->section])
+		glDeleteSync(this->fences[this->section]);
+	this->fences[this->section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	this->section = (this->section + 1) % STREAM_BUFFER_SECTIONS;
+	this->head = 0;
+
+	GLsync fence = this->fences[this->section];
+	if (!fence)
+		return;
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED)
+	{
+		this->stallCount++;
+		while (status == GL_TIMEOUT_EXPIRED)
+			status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+	}
+	glDeleteSync(fence);
+	this->fences[this->section] = nullptr;
+}
+
+void	StreamBuffer::beginFrame()
+{
+	this->nextSection();
+}
+
+// Copy data in the current section, returns its offset in the buffer or -1 when the section is full
+GLintptr	StreamBuffer::upload(const void* data, GLsizeiptr size, GLsizeiptr alignment)
+{
+	GLsizeiptr aligned = (this->head + alignment - 1) / alignment * alignment;
+	if (aligned + size > this->sectionSize)
+		return -1;
+
+	GLintptr offset = this->section * this->sectionSize + aligned;
+	if (this->mapped)
+		std::memcpy(this->mapped + offset, data, size);
+	else
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, this->buffer);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+	this->head = aligned + size;
+	return offset;
+}
+
+// Stage data through the ring and copy it into dstBuffer on the GPU, section by section
+void	StreamBuffer::copyToBuffer(uint dstBuffer, GLintptr dstOffset, const void* data, GLsizeiptr size)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+	while (size > 0)
+	{
+		GLsizeiptr available = this->sectionSize - (this->head + 3) / 4 * 4;
+		if (available <= 0)
+		{
+			this->nextSection();
+			continue;
+		}
+
+		GLsizeiptr chunk = std::min(size, available);
+		GLintptr offset = this->upload(bytes, chunk, 4);
+
+		glBindBuffer(GL_COPY_READ_BUFFER, this->buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, dstBuffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, dstOffset, chunk);
+
+		bytes += chunk;
+		dstOffset += chunk;
+		size -= chunk;
+	}
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+uint	StreamBuffer::getBuffer() const
+{
+	return this->buffer;
+}
+
+bool	StreamBuffer::isPersistent() const
+{
+	return this->mapped != nullptr;
+}
+
+uint	StreamBuffer::getStallCount() const
+{
+	return this->stallCount;
+}
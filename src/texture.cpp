@@ -0,0 +1,52 @@
+#include "../include/Texture.hpp"
+#include <cmath>
+
+TextureFormat	textureFormatFor(int channels, bool srgb)
+{
+	switch (channels)
+	{
+		case 1:
+			return { static_cast<GLenum>(srgb ? GL_SRGB8 : GL_R8), GL_RED, 1 };
+		case 2:
+			if (srgb)
+				return { GL_SRGB8_ALPHA8, GL_RGBA, 4 };
+			return { GL_RG8, GL_RG, 2 };
+		case 4:
+			return { static_cast<GLenum>(srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8), GL_RGBA, 4 };
+		default:
+			return { static_cast<GLenum>(srgb ? GL_SRGB8 : GL_RGB8), GL_RGB, 3 };
+	}
+}
+
+void	applyTextureSwizzle(GLenum target, const TextureFormat& format)
+{
+	GLint grey[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+	GLint greyAlpha[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+
+	if (format.channels == 1)
+		glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, grey);
+	else if (format.channels == 2)
+		glTexParameteriv(target, GL_TEXTURE_SWIZZLE_RGBA, greyAlpha);
+}
+
+// Rows of tightly packed images are only aligned on what their size allows
+void	setUnpackAlignment(GLsizeiptr rowSize)
+{
+	int alignment = 8;
+	while (rowSize % alignment != 0)
+		alignment /= 2;
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+}
+
+int	mipLevelCount(int width, int height)
+{
+	return 1 + static_cast<int>(std::floor(std::log2(std::max(std::max(width, height), 1))));
+}
+
+// sRGB textures are only worth it when the default framebuffer encodes back to sRGB
+bool	isFramebufferSrgb()
+{
+	GLint encoding = GL_LINEAR;
+	glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_BACK_LEFT, GL_FRAMEBUFFER_ATTACHMENT_COLOR_ENCODING, &encoding);
+	return encoding == GL_SRGB;
+}
@@ -0,0 +1,143 @@
+#include "../include/TextureCache.hpp"
+#include "../include/MemoryStats.hpp"
+
+TextureCache::TextureCache(size_t budget)
+{
+	this->budget = budget;
+	this->useCounter = 0;
+	this->stats = {};
+}
+
+TextureCache::~TextureCache()
+{
+	for (const auto& entry : this->entries)
+		this->destroy(entry.second);
+	for (const Entry& entry : this->stale)
+		this->destroy(entry);
+}
+
+std::string	TextureCache::canonicalPath(const char* filePathName)
+{
+	std::error_code error;
+	std::filesystem::path path = std::filesystem::weakly_canonical(filePathName, error);
+	return error ? std::string(filePathName) : path.string();
+}
+
+static std::filesystem::file_time_type	modificationTime(const std::string& path)
+{
+	std::error_code error;
+	std::filesystem::file_time_type mtime = std::filesystem::last_write_time(path, error);
+	return error ? std::filesystem::file_time_type() : mtime;
+}
+
+void	TextureCache::destroy(const Entry& entry)
+{
+	glDeleteTextures(1, &entry.texture);
+	untrackGpuResource(GPU_TEXTURE, entry.texture);
+	this->stats.bytes -= entry.bytes;
+}
+
+// Returns a referenced texture, or 0 when the caller has to load it and insert() it
+uint	TextureCache::acquire(const std::string& path)
+{
+	auto it = this->entries.find(path);
+	if (it != this->entries.end() && it->second.mtime != modificationTime(path))
+	{
+		// Changed on disk: users of the old texture keep it until they release it
+		if (it->second.references > 0)
+			this->stale.push_back(it->second);
+		else
+			this->destroy(it->second);
+		this->entries.erase(it);
+		it = this->entries.end();
+	}
+
+	if (it == this->entries.end())
+	{
+		this->stats.misses++;
+		return 0;
+	}
+
+	this->stats.hits++;
+	it->second.references++;
+	it->second.lastUse = ++this->useCounter;
+	return it->second.texture;
+}
+
+// The inserted texture starts with one reference, held by the caller
+void	TextureCache::insert(const std::string& path, uint texture, size_t bytes)
+{
+	auto it = this->entries.find(path);
+	if (it != this->entries.end())
+	{
+		if (it->second.references > 0)
+			this->stale.push_back(it->second);
+		else
+			this->destroy(it->second);
+		this->entries.erase(it);
+	}
+
+	this->entries[path] = { texture, bytes, 1, ++this->useCounter, modificationTime(path) };
+	this->stats.bytes += bytes;
+	this->stats.entries = this->entries.size();
+	this->evict();
+}
+
+void	TextureCache::release(uint texture)
+{
+	if (texture == 0)
+		return;
+
+	for (auto& entry : this->entries)
+	{
+		if (entry.second.texture == texture && entry.second.references > 0)
+		{
+			entry.second.references--;
+			this->evict();
+			return;
+		}
+	}
+	for (size_t i = 0; i < this->stale.size(); i++)
+	{
+		if (this->stale[i].texture == texture && --this->stale[i].references == 0)
+		{
+			this->destroy(this->stale[i]);
+			this->stale.erase(this->stale.begin() + i);
+			return;
+		}
+	}
+}
+
+void	TextureCache::evict()
+{
+	while (this->stats.bytes > this->budget)
+	{
+		auto victim = this->entries.end();
+		for (auto it = this->entries.begin(); it != this->entries.end(); ++it)
+			if (it->second.references == 0 && (victim == this->entries.end() || it->second.lastUse < victim->second.lastUse))
+				victim = it;
+		if (victim == this->entries.end())
+			break;
+
+		this->destroy(victim->second);
+		this->entries.erase(victim);
+		this->stats.evictions++;
+	}
+	this->stats.entries = this->entries.size();
+}
+
+void	TextureCache::setBudget(size_t budget)
+{
+	this->budget = budget;
+	this->evict();
+}
+
+size_t	TextureCache::getBudget() const
+{
+	return this->budget;
+}
+
+const TextureCacheStats&	TextureCache::getStats() const
+{
+	return this->stats;
+}
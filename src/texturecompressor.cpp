@@ -0,0 +1,398 @@
+#include "../include/TextureCompressor.hpp"
+#include "../include/JobSystem.hpp"
+#include "../imgui/stb_image.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+// Principal axis of the block in `channels` dimensions, by power iteration on the covariance
+static void	principalAxis(const unsigned char pixels[64], int channels, float mean[4], float axis[4])
+{
+	float covariance[4][4] = {};
+
+	for (int c = 0; c < channels; c++)
+	{
+		mean[c] = 0.0f;
+		for (int i = 0; i < 16; i++)
+			mean[c] += pixels[i * 4 + c];
+		mean[c] /= 16.0f;
+	}
+	for (int i = 0; i < 16; i++)
+		for (int a = 0; a < channels; a++)
+			for (int b = 0; b < channels; b++)
+				covariance[a][b] += (pixels[i * 4 + a] - mean[a]) * (pixels[i * 4 + b] - mean[b]);
+
+	for (int c = 0; c < channels; c++)
+		axis[c] = 1.0f;
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		float next[4] = {};
+		float length = 0.0f;
+		for (int a = 0; a < channels; a++)
+		{
+			for (int b = 0; b < channels; b++)
+				next[a] += covariance[a][b] * axis[b];
+			length = std::max(length, std::fabs(next[a]));
+		}
+		if (length == 0.0f)
+			return;
+		for (int c = 0; c < channels; c++)
+			axis[c] = next[c] / length;
+	}
+}
+
+// Endpoints at the extreme projections of the block on its principal axis
+static void	blockEndpoints(const unsigned char pixels[64], int channels, float low[4], float high[4])
+{
+	float mean[4], axis[4];
+	float minProjection = 0.0f, maxProjection = 0.0f;
+	float axisLength = 0.0f;
+
+	principalAxis(pixels, channels, mean, axis);
+	for (int c = 0; c < channels; c++)
+		axisLength += axis[c] * axis[c];
+	for (int i = 0; i < 16 && axisLength > 0.0f; i++)
+	{
+		float projection = 0.0f;
+		for (int c = 0; c < channels; c++)
+			projection += (pixels[i * 4 + c] - mean[c]) * axis[c];
+		minProjection = std::min(minProjection, projection / axisLength);
+		maxProjection = std::max(maxProjection, projection / axisLength);
+	}
+	for (int c = 0; c < channels; c++)
+	{
+		low[c] = std::min(std::max(mean[c] + axis[c] * minProjection, 0.0f), 255.0f);
+		high[c] = std::min(std::max(mean[c] + axis[c] * maxProjection, 0.0f), 255.0f);
+	}
+}
+
+static int	colorDistance(const unsigned char* a, const int* b, int channels)
+{
+	int distance = 0;
+	for (int c = 0; c < channels; c++)
+		distance += (a[c] - b[c]) * (a[c] - b[c]);
+	return distance;
+}
+
+static unsigned short	packRgb565(const float color[4])
+{
+	int r = static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f);
+	int g = static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f);
+	int b = static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f);
+	return static_cast<unsigned short>((r << 11) | (g << 5) | b);
+}
+
+static void	unpackRgb565(unsigned short packed, int color[4])
+{
+	color[0] = ((packed >> 11) & 31) * 255 / 31;
+	color[1] = ((packed >> 5) & 63) * 255 / 63;
+	color[2] = (packed & 31) * 255 / 31;
+}
+
+// Four color mode only (color0 > color1), alpha is ignored
+void	encodeBc1Block(const unsigned char pixels[64], unsigned char block[8])
+{
+	float low[4], high[4];
+	blockEndpoints(pixels, 3, low, high);
+
+	unsigned short color0 = packRgb565(high);
+	unsigned short color1 = packRgb565(low);
+	if (color0 < color1)
+		std::swap(color0, color1);
+
+	uint indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][4];
+		unpackRgb565(color0, palette[0]);
+		unpackRgb565(color1, palette[1]);
+		for (int c = 0; c < 3; c++)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			uint best = 0;
+			int bestDistance = colorDistance(&pixels[i * 4], palette[0], 3);
+			for (uint p = 1; p < 4; p++)
+			{
+				int distance = colorDistance(&pixels[i * 4], palette[p], 3);
+				if (distance < bestDistance)
+				{
+					best = p;
+					bestDistance = distance;
+				}
+			}
+			indices |= best << (i * 2);
+		}
+	}
+
+	std::memcpy(block, &color0, 2);
+	std::memcpy(block + 2, &color1, 2);
+	std::memcpy(block + 4, &indices, 4);
+}
+
+// LSB first bit writer over a 16 byte block
+struct BitWriter
+{
+	unsigned char*	block;
+	int				position;
+
+	void	write(uint value, int bits) {
+		for (int i = 0; i < bits; i++, this->position++)
+			if (value & (1u << i))
+				this->block[this->position / 8] |= 1 << (this->position % 8);
+	}
+};
+
+// Endpoint channel on 7 bits plus the shared p-bit that completes it to 8 bits
+static int	quantizeBc7Endpoint(const float color[4], int pbit, int quantized[4])
+{
+	int error = 0;
+	for (int c = 0; c < 4; c++)
+	{
+		int q = static_cast<int>((color[c] - pbit) / 2.0f + 0.5f);
+		quantized[c] = std::min(std::max(q, 0), 127);
+		int value = (quantized[c] << 1) | pbit;
+		error += (value - static_cast<int>(color[c] + 0.5f)) * (value - static_cast<int>(color[c] + 0.5f));
+	}
+	return error;
+}
+
+// Mode 6: one subset, RGBA endpoints 7.7.7.7 + p-bit, 4 bit indices
+void	encodeBc7Block(const unsigned char pixels[64], unsigned char block[16])
+{
+	static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+	float endpoints[2][4];
+	int quantized[2][4];
+	int pbits[2];
+
+	blockEndpoints(pixels, 4, endpoints[0], endpoints[1]);
+	for (int e = 0; e < 2; e++)
+	{
+		int candidate[4];
+		int error0 = quantizeBc7Endpoint(endpoints[e], 0, quantized[e]);
+		int error1 = quantizeBc7Endpoint(endpoints[e], 1, candidate);
+		pbits[e] = error1 < error0;
+		if (pbits[e])
+			std::memcpy(quantized[e], candidate, sizeof(candidate));
+	}
+
+	int palette[16][4];
+	for (int c = 0; c < 4; c++)
+	{
+		int e0 = (quantized[0][c] << 1) | pbits[0];
+		int e1 = (quantized[1][c] << 1) | pbits[1];
+		for (int i = 0; i < 16; i++)
+			palette[i][c] = ((64 - weights[i]) * e0 + weights[i] * e1 + 32) >> 6;
+	}
+
+	uint indices[16];
+	for (int i = 0; i < 16; i++)
+	{
+		indices[i] = 0;
+		int bestDistance = colorDistance(&pixels[i * 4], palette[0], 4);
+		for (uint p = 1; p < 16; p++)
+		{
+			int distance = colorDistance(&pixels[i * 4], palette[p], 4);
+			if (distance < bestDistance)
+			{
+				indices[i] = p;
+				bestDistance = distance;
+			}
+		}
+	}
+
+	// The anchor index has an implicit 0 MSB, swapping the endpoints flips every index
+	if (indices[0] & 8)
+	{
+		std::swap(quantized[0], quantized[1]);
+		std::swap(pbits[0], pbits[1]);
+		for (int i = 0; i < 16; i++)
+			indices[i] = 15 - indices[i];
+	}
+
+	std::memset(block, 0, 16);
+	BitWriter writer = { block, 0 };
+	writer.write(1u << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		writer.write(quantized[0][c], 7);
+		writer.write(quantized[1][c], 7);
+	}
+	writer.write(pbits[0], 1);
+	writer.write(pbits[1], 1);
+	writer.write(indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		writer.write(indices[i], 4);
+}
+
+struct RgbaImage
+{
+	int							width;
+	int							height;
+	std::vector<unsigned char>	pixels;
+};
+
+static RgbaImage	downsample(const RgbaImage& source)
+{
+	RgbaImage image;
+	image.width = std::max(source.width / 2, 1);
+	image.height = std::max(source.height / 2, 1);
+	image.pixels.resize((size_t)image.width * image.height * 4);
+
+	for (int y = 0; y < image.height; y++)
+	{
+		for (int x = 0; x < image.width; x++)
+		{
+			int x0 = std::min(x * 2, source.width - 1), x1 = std::min(x * 2 + 1, source.width - 1);
+			int y0 = std::min(y * 2, source.height - 1), y1 = std::min(y * 2 + 1, source.height - 1);
+			for (int c = 0; c < 4; c++)
+			{
+				int sum = source.pixels[((size_t)y0 * source.width + x0) * 4 + c] + source.pixels[((size_t)y0 * source.width + x1) * 4 + c]
+					+ source.pixels[((size_t)y1 * source.width + x0) * 4 + c] + source.pixels[((size_t)y1 * source.width + x1) * 4 + c];
+				image.pixels[((size_t)y * image.width + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+			}
+		}
+	}
+	return image;
+}
+
+// Block rows are spread over the job system, edge blocks repeat the last row / column
+static void	encodeLevel(const RgbaImage& image, BlockFormat format, unsigned char* output)
+{
+	int blocksWide = (image.width + 3) / 4;
+	int blocksHigh = (image.height + 3) / 4;
+	size_t blockSize = format == BLOCK_BC1 ? 8 : 16;
+
+	jobSystem().parallelFor("encode blocks", blocksHigh, 1, [&](size_t begin, size_t end) {
+		unsigned char pixels[64];
+		for (int by = begin; by < (int)end; by++)
+		{
+			for (int bx = 0; bx < blocksWide; bx++)
+			{
+				for (int i = 0; i < 16; i++)
+				{
+					int x = std::min(bx * 4 + i % 4, image.width - 1);
+					int y = std::min(by * 4 + i / 4, image.height - 1);
+					std::memcpy(&pixels[i * 4], &image.pixels[((size_t)y * image.width + x) * 4], 4);
+				}
+				unsigned char* block = output + ((size_t)by * blocksWide + bx) * blockSize;
+				if (format == BLOCK_BC1)
+					encodeBc1Block(pixels, block);
+				else
+					encodeBc7Block(pixels, block);
+			}
+		}
+	});
+}
+
+// The downsample chain runs ahead of the encoders, every level is encoded as soon as its pixels exist
+uint	compressMipChain(const unsigned char* rgba, int width, int height, BlockFormat format, std::vector<unsigned char>& output)
+{
+	uint mipCount = 1 + static_cast<uint>(std::floor(std::log2(std::max(width, height))));
+	std::vector<RgbaImage> levels(mipCount);
+	std::vector<size_t> offsets(mipCount);
+
+	size_t offset = output.size();
+	for (uint level = 0; level < mipCount; level++)
+	{
+		offsets[level] = offset;
+		offset += compressedLevelSize(format, std::max(width >> level, 1), std::max(height >> level, 1));
+	}
+	output.resize(offset);
+	levels[0].width = width;
+	levels[0].height = height;
+	levels[0].pixels.assign(rgba, rgba + (size_t)width * height * 4);
+
+	JobSystem& jobs = jobSystem();
+	std::vector<JobHandle> images(mipCount);
+	std::vector<JobHandle> encoders;
+	for (uint level = 0; level < mipCount; level++)
+	{
+		if (level > 0)
+			images[level] = jobs.submit("downsample", [&levels, level]() { levels[level] = downsample(levels[level - 1]); },
+				level > 1 ? std::vector<JobHandle>{ images[level - 1] } : std::vector<JobHandle>());
+		encoders.push_back(jobs.submit("encode level", [&levels, &offsets, &output, format, level]() {
+			encodeLevel(levels[level], format, &output[offsets[level]]);
+		}, level > 0 ? std::vector<JobHandle>{ images[level] } : std::vector<JobHandle>()));
+	}
+	jobs.wait(encoders);
+	return mipCount;
+}
+
+static void	writeU32(std::vector<unsigned char>& out, size_t offset, uint value)
+{
+	std::memcpy(&out[offset], &value, sizeof(value));
+}
+
+// BC1 uses the legacy DXT1 FourCC, BC7 needs the DX10 extension header
+static std::vector<unsigned char>	ddsHeader(BlockFormat format, int width, int height, uint mipCount)
+{
+	bool dx10 = format == BLOCK_BC7;
+	std::vector<unsigned char> header(128 + (dx10 ? 20 : 0), 0);
+
+	std::memcpy(&header[0], "DDS ", 4);
+	writeU32(header, 4, 124);
+	writeU32(header, 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000); // caps, height, width, pixel format, mip count, linear size
+	writeU32(header, 12, height);
+	writeU32(header, 16, width);
+	writeU32(header, 20, compressedLevelSize(format, width, height));
+	writeU32(header, 28, mipCount);
+	writeU32(header, 76, 32);
+	writeU32(header, 80, 0x4); // DDPF_FOURCC
+	std::memcpy(&header[84], dx10 ? "DX10" : (format == BLOCK_BC1 ? "DXT1" : "DXT5"), 4);
+	writeU32(header, 108, 0x1000 | 0x400000 | 0x8); // texture, mipmap, complex
+	if (dx10)
+	{
+		writeU32(header, 128, 98); // DXGI_FORMAT_BC7_UNORM
+		writeU32(header, 132, 3); // D3D10_RESOURCE_DIMENSION_TEXTURE2D
+		writeU32(header, 140, 1); // array size
+	}
+	return header;
+}
+
+int	runTextureCompressor(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: ./scop --compress input output.dds [bc1|bc7]" << std::endl;
+		return 1;
+	}
+	BlockFormat format = argc > 2 && std::strcmp(argv[2], "bc1") == 0 ? BLOCK_BC1 : BLOCK_BC7;
+
+	// Blocks are written in GL row order, like every other texture the viewer loads
+	int width, height, channels;
+	stbi_set_flip_vertically_on_load(1);
+	unsigned char* data = stbi_load(argv[0], &width, &height, &channels, 4);
+	if (!data)
+	{
+		std::cerr << "Error: could not load " << argv[0] << std::endl;
+		return 1;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	uint mipCount = 1 + static_cast<uint>(std::floor(std::log2(std::max(width, height))));
+	std::vector<unsigned char> output = ddsHeader(format, width, height, mipCount);
+	compressMipChain(data, width, height, format, output);
+	stbi_image_free(data);
+	size_t uncompressed = 0;
+	for (uint level = 0; level < mipCount; level++)
+		uncompressed += (size_t)std::max(width >> level, 1) * std::max(height >> level, 1) * channels;
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::ofstream file(argv[1], std::ios::out | std::ios::binary);
+	if (!file.is_open() || !file.write(reinterpret_cast<const char*>(output.data()), output.size()))
+	{
+		std::cerr << "Error: could not write " << argv[1] << std::endl;
+		return 1;
+	}
+
+	std::cout << argv[1] << ": " << (format == BLOCK_BC1 ? "BC1" : "BC7") << ", " << mipCount << " levels, "
+		<< uncompressed << " -> " << output.size() << " bytes, " << ms << " ms on "
+		<< jobSystem().getThreadCount() << " threads" << std::endl;
+	return 0;
+}
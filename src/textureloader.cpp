@@ -0,0 +1,310 @@
+#include "../include/TextureLoader.hpp"
+#include "../include/MemoryStats.hpp"
+#include "../include/Trace.hpp"
+#include "../imgui/stb_image.h"
+#include <cstring>
+#include <iostream>
+
+TextureLoader::Job::Job(const char* filename) : path(filename), data(nullptr), width(0), height(0), channels(0), isCompressed(false), isBmp(false), ready(false)
+{
+}
+
+TextureLoader::Job::~Job()
+{
+	stbi_image_free(this->data);
+}
+
+size_t	TextureLoader::Job::rowStride() const
+{
+	return this->isBmp ? this->bmp.getRowStride() : (size_t)this->width * this->channels;
+}
+
+const unsigned char*	TextureLoader::Job::row(int y) const
+{
+	return this->isBmp ? this->bmp.getRow(y) : this->data + y * this->rowStride();
+}
+
+TextureLoader::TextureLoader(bool srgb)
+{
+	this->srgb = srgb;
+	this->texture = 0;
+	this->pixelBuffer = 0;
+	this->uploadedRows = 0;
+	this->uploadedLevels = 0;
+	this->stopping = false;
+	this->worker = std::thread(&TextureLoader::decodeLoop, this);
+}
+
+// A decode in progress cannot be interrupted, the destructor waits for it
+TextureLoader::~TextureLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+		this->pending.reset();
+	}
+	this->wake.notify_one();
+	this->worker.join();
+	this->cancelUpload();
+}
+
+// A newer request replaces the pending one, a job the worker is already decoding
+// finishes and is dropped with its last reference
+void	TextureLoader::request(const char* filename)
+{
+	this->cancelUpload();
+	this->job = std::make_shared<Job>(filename);
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->pending = this->job;
+	}
+	this->wake.notify_one();
+}
+
+// A decode already started finishes on the worker, its result is simply never uploaded
+void	TextureLoader::cancel()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->pending.reset();
+	}
+	this->cancelUpload();
+}
+
+void	TextureLoader::decodeLoop()
+{
+	traceThreadName("texture decode");
+	std::unique_lock<std::mutex> lock(this->mutex);
+	while (true)
+	{
+		this->wake.wait(lock, [this]() { return this->stopping || this->pending; });
+		if (this->stopping)
+			return;
+		std::shared_ptr<Job> job = std::move(this->pending);
+		lock.unlock();
+
+		TRACE_SCOPE("decode texture");
+		job->isCompressed = isCompressedTextureFile(job->path);
+		job->isBmp = !job->isCompressed && isBmpFile(job->path) && job->bmp.open(job->path.c_str());
+		if (job->isBmp)
+		{
+			job->width = job->bmp.getWidth();
+			job->height = job->bmp.getHeight();
+			job->channels = job->bmp.getChannels();
+		}
+		else if (!job->isCompressed)
+		{
+			// decoded to the channel count of its upload format, grey + alpha may become RGBA
+			int channels = 0;
+			if (stbi_info(job->path.c_str(), &job->width, &job->height, &channels))
+				channels = textureFormatFor(channels, this->srgb).channels;
+			job->data = stbi_load(job->path.c_str(), &job->width, &job->height, &job->channels, channels);
+			job->channels = channels ? channels : job->channels;
+		}
+		else if (loadCompressedTexture(job->path.c_str(), job->compressed))
+		{
+			job->width = job->compressed.width;
+			job->height = job->compressed.height;
+		}
+		job->ready.store(true, std::memory_order_release);
+		job.reset();
+		lock.lock();
+	}
+}
+
+bool	TextureLoader::busy() const
+{
+	return this->job != nullptr;
+}
+
+float	TextureLoader::progress() const
+{
+	if (!this->job || !this->texture)
+		return 0.0f;
+	if (this->job->isCompressed)
+		return static_cast<float>(this->uploadedLevels) / this->job->compressed.levels.size();
+	return static_cast<float>(this->uploadedRows) / this->job->height;
+}
+
+void	TextureLoader::cancelUpload()
+{
+	glDeleteTextures(1, &this->texture);
+	glDeleteBuffers(1, &this->pixelBuffer);
+	untrackGpuResource(GPU_TEXTURE, this->texture);
+	untrackGpuResource(GPU_BUFFER, this->pixelBuffer);
+	this->texture = 0;
+	this->pixelBuffer = 0;
+	this->uploadedRows = 0;
+	this->uploadedLevels = 0;
+	this->job.reset();
+}
+
+void	TextureLoader::beginUpload()
+{
+	const Job& job = *this->job;
+	GLsizeiptr size;
+	int levels;
+
+	if (job.isCompressed)
+	{
+		this->format = { compressedInternalFormat(job.compressed.format, this->srgb), 0, 4 };
+		levels = static_cast<int>(job.compressed.levels.size());
+		size = job.compressed.data.size();
+	}
+	else
+	{
+		this->format = textureFormatFor(job.channels, this->srgb);
+		levels = mipLevelCount(job.width, job.height);
+		size = (GLsizeiptr)job.rowStride() * job.height;
+		if (job.isBmp)
+			this->format.format = job.bmp.getFormat();
+	}
+
+	glGenTextures(1, &this->texture);
+	glBindTexture(GL_TEXTURE_2D, this->texture);
+	glTexStorage2D(GL_TEXTURE_2D, levels, this->format.internalFormat, job.width, job.height);
+	applyTextureSwizzle(GL_TEXTURE_2D, this->format);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	trackGpuResource(GPU_TEXTURE, this->texture, "model texture", textureStorageBytes(this->format.internalFormat, job.width, job.height, 1, levels));
+
+	glGenBuffers(1, &this->pixelBuffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pixelBuffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	trackGpuResource(GPU_BUFFER, this->pixelBuffer, "texture upload", size);
+	this->uploadedRows = 0;
+	this->uploadedLevels = 0;
+}
+
+// Each chunk goes to its own range of the PBO, no synchronization with the previous ones
+static unsigned char*	mapPixelBuffer(GLintptr offset, GLsizeiptr size)
+{
+	unsigned char* mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, offset, size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+	if (!mapped)
+		std::cerr << "Error: could not map the texture upload buffer" << std::endl;
+	return mapped;
+}
+
+static bool	copyToPixelBuffer(GLintptr offset, const void* data, GLsizeiptr size)
+{
+	unsigned char* mapped = mapPixelBuffer(offset, size);
+	if (!mapped)
+		return false;
+	std::memcpy(mapped, data, size);
+	glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	return true;
+}
+
+// Returns true once every row of the base level is uploaded, the upload is dropped when the PBO cannot be mapped.
+// Only top-down BMPs are copied a row at a time, everything else is already in GL order.
+bool	TextureLoader::uploadRows()
+{
+	const Job& job = *this->job;
+	GLsizeiptr rowSize = job.rowStride();
+	int rows = std::min(std::max(static_cast<int>(TEXTURE_UPLOAD_CHUNK / rowSize), 1), job.height - this->uploadedRows);
+	GLintptr offset = this->uploadedRows * rowSize;
+
+	if (!job.isBmp || job.bmp.isBottomUp())
+	{
+		if (!copyToPixelBuffer(offset, job.row(this->uploadedRows), rows * rowSize))
+		{
+			this->cancelUpload();
+			return false;
+		}
+	}
+	else
+	{
+		unsigned char* mapped = mapPixelBuffer(offset, rows * rowSize);
+		if (!mapped)
+		{
+			this->cancelUpload();
+			return false;
+		}
+		for (int y = 0; y < rows; y++)
+			std::memcpy(mapped + y * rowSize, job.row(this->uploadedRows + y), rowSize);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+	}
+	setUnpackAlignment(rowSize);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, this->uploadedRows, job.width, rows, this->format.format, GL_UNSIGNED_BYTE, (void*)offset);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	this->uploadedRows += rows;
+
+	if (this->uploadedRows < job.height)
+		return false;
+	glGenerateMipmap(GL_TEXTURE_2D);
+	return true;
+}
+
+// Whole levels, at least one per frame, the file's mip chain replaces glGenerateMipmap
+bool	TextureLoader::uploadLevels()
+{
+	const CompressedImage& image = this->job->compressed;
+	size_t budget = 0;
+
+	while (this->uploadedLevels < image.levels.size() && (budget == 0 || budget + image.levels[this->uploadedLevels].size <= TEXTURE_UPLOAD_CHUNK))
+	{
+		const CompressedLevel& level = image.levels[this->uploadedLevels];
+		if (!copyToPixelBuffer(level.offset, image.data.data() + level.offset, level.size))
+		{
+			this->cancelUpload();
+			return false;
+		}
+		glCompressedTexSubImage2D(GL_TEXTURE_2D, this->uploadedLevels, 0, 0, level.width, level.height,
+			this->format.internalFormat, compressedLevelSize(image.format, level.width, level.height), (void*)level.offset);
+		budget += level.size;
+		this->uploadedLevels++;
+	}
+	return this->uploadedLevels == image.levels.size();
+}
+
+// Called once per frame, returns true when a texture is finished (the caller owns it)
+bool	TextureLoader::update(LoadedTexture& loaded)
+{
+	if (!this->job || !this->job->ready.load(std::memory_order_acquire))
+		return false;
+
+	bool decoded = this->job->isCompressed ? !this->job->compressed.levels.empty() : this->job->isBmp || this->job->data != nullptr;
+	if (!decoded || (this->job->isCompressed && !isCompressedFormatSupported(this->job->compressed.format)))
+	{
+		std::cerr << "Error: could not load texture " << this->job->path << std::endl;
+		this->cancelUpload();
+		return false;
+	}
+	if (!this->texture)
+		this->beginUpload();
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pixelBuffer);
+	glBindTexture(GL_TEXTURE_2D, this->texture);
+	bool complete = this->job->isCompressed ? this->uploadLevels() : this->uploadRows();
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (!complete)
+	{
+		glBindTexture(GL_TEXTURE_2D, 0);
+		return false;
+	}
+
+	if (!this->job->isCompressed || this->job->compressed.levels.size() > 1)
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	loaded.texture = this->texture;
+	loaded.path = this->job->path;
+	if (this->job->isCompressed)
+	{
+		loaded.bytes = 0;
+		for (const CompressedLevel& level : this->job->compressed.levels)
+			loaded.bytes += compressedLevelSize(this->job->compressed.format, level.width, level.height);
+	}
+	else
+		loaded.bytes = (size_t)this->job->width * this->job->height * this->format.channels * 4 / 3;
+	this->texture = 0;
+	this->cancelUpload();
+	return true;
+}
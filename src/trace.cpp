@@ -0,0 +1,171 @@
+#include "../include/Trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Fields are relaxed atomics so writeTrace() may read a slot while its thread rewrites it
+struct TraceRecord
+{
+	std::atomic<const char*>	name;
+	std::atomic<uint64_t>		start;
+	std::atomic<uint64_t>		end;
+};
+
+struct TraceEvent
+{
+	const char*	name;
+	uint64_t	start;
+	uint64_t	end;
+};
+
+struct TraceBuffer
+{
+	TraceRecord				events[TRACE_BUFFER_EVENTS];
+	std::atomic<uint64_t>	count; // events ever written, the last TRACE_BUFFER_EVENTS are kept
+	uint					id;
+	std::string				threadName;
+	bool					owned; // a buffer is reused once its thread exits
+};
+
+// Buffers are only added or handed over under the mutex, never freed
+struct TraceRegistry
+{
+	std::mutex									mutex;
+	std::vector<std::unique_ptr<TraceBuffer>>	buffers;
+};
+
+struct TraceThread
+{
+	TraceBuffer*	buffer = nullptr;
+	~TraceThread();
+};
+
+std::atomic<bool>	traceEnabled(true);
+static const uint64_t	traceEpoch = traceNow();
+static thread_local TraceThread	traceThread;
+
+// Never destroyed: threads of static pools still release their buffer after the statics are gone
+static TraceRegistry&	traceRegistry()
+{
+	static TraceRegistry* registry = new TraceRegistry;
+	return *registry;
+}
+
+TraceThread::~TraceThread()
+{
+	if (!this->buffer)
+		return;
+	std::lock_guard<std::mutex> lock(traceRegistry().mutex);
+	this->buffer->owned = false;
+}
+
+uint64_t	traceNow()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// First event of a thread, the only time recording takes the lock
+static TraceBuffer*	threadBuffer()
+{
+	if (traceThread.buffer)
+		return traceThread.buffer;
+
+	TraceRegistry& registry = traceRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	for (std::unique_ptr<TraceBuffer>& buffer : registry.buffers)
+	{
+		if (buffer->owned)
+			continue;
+		buffer->owned = true;
+		buffer->count = 0;
+		buffer->threadName.clear();
+		traceThread.buffer = buffer.get();
+		return traceThread.buffer;
+	}
+	registry.buffers.push_back(std::make_unique<TraceBuffer>());
+	TraceBuffer* buffer = registry.buffers.back().get();
+	buffer->count = 0;
+	buffer->id = static_cast<uint>(registry.buffers.size());
+	buffer->owned = true;
+	traceThread.buffer = buffer;
+	return buffer;
+}
+
+void	traceEvent(const char* name, uint64_t start, uint64_t end)
+{
+	TraceBuffer* buffer = threadBuffer();
+	uint64_t index = buffer->count.load(std::memory_order_relaxed);
+	TraceRecord& record = buffer->events[index % TRACE_BUFFER_EVENTS];
+	record.name.store(name, std::memory_order_relaxed);
+	record.start.store(start, std::memory_order_relaxed);
+	record.end.store(end, std::memory_order_relaxed);
+	buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void	traceThreadName(const char* name)
+{
+	TraceBuffer* buffer = threadBuffer();
+	std::lock_guard<std::mutex> lock(traceRegistry().mutex);
+	buffer->threadName = name;
+}
+
+void	setTraceEnabled(bool enabled)
+{
+	traceEnabled = enabled;
+}
+
+// Complete ("X") events in microseconds since startup, one track per thread
+bool	writeTrace(const std::string& path)
+{
+	std::ofstream file(path, std::ios::out | std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cerr << "Warning: could not write trace " << path << std::endl;
+		return false;
+	}
+	file.setf(std::ios::fixed);
+	file.precision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"scop\"}}";
+
+	TraceRegistry& registry = traceRegistry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	std::vector<TraceEvent> events;
+	for (const std::unique_ptr<TraceBuffer>& buffer : registry.buffers)
+	{
+		std::string threadName = buffer->threadName.empty() ? "thread " + std::to_string(buffer->id) : buffer->threadName;
+		file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->id
+			<< ",\"args\":{\"name\":\"" << threadName << "\"}}";
+
+		uint64_t end = buffer->count.load(std::memory_order_acquire);
+		uint64_t begin = end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0;
+		events.clear();
+		for (uint64_t i = begin; i < end; i++)
+		{
+			const TraceRecord& record = buffer->events[i % TRACE_BUFFER_EVENTS];
+			events.push_back({ record.name.load(std::memory_order_relaxed), record.start.load(std::memory_order_relaxed),
+				record.end.load(std::memory_order_relaxed) });
+		}
+		// the slots the thread reached meanwhile, including the one it may be writing, are torn
+		uint64_t after = buffer->count.load(std::memory_order_acquire);
+		uint64_t first = after + 1 > TRACE_BUFFER_EVENTS ? after + 1 - TRACE_BUFFER_EVENTS : 0;
+		for (uint64_t i = std::max(begin, first); i < end; i++)
+		{
+			const TraceEvent& event = events[i - begin];
+			file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+				<< ",\"ts\":" << (event.start - traceEpoch) / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+		}
+	}
+	file << "\n]}\n";
+	file.close();
+	if (!file)
+	{
+		std::cerr << "Warning: could not write trace " << path << std::endl;
+		return false;
+	}
+	return true;
+}
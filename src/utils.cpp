@@ -1,10 +1,14 @@
 #include "../include/Scop.hpp"
+// Decoded images are counted as texture memory
+#define STBI_MALLOC(size)			trackedMalloc(MEMORY_TEXTURES, size)
+#define STBI_REALLOC(pointer, size)	trackedRealloc(MEMORY_TEXTURES, pointer, size)
+#define STBI_FREE(pointer)			trackedFree(pointer)
 #define STB_IMAGE_IMPLEMENTATION
 #include "../imgui/stb_image.h"
 
 void	Scop::updateUI()
 {
-	ImGui_ImplOpenGL3_NewFrame();
+	TRACE_SCOPE("updateUI");
 	ImGui_ImplGlfw_NewFrame();
 	ImGui::NewFrame();
 
@@ -12,10 +16,23 @@ void	Scop::updateUI()
 	{
 		this->fps = static_cast<float>(this->frames) / this->totalTime;
 		this->frames = 0;
-		this->totalTime = 0.0f;
+		this->totalTime = 0.0;
 	}
 	ImGui::Begin("scop");
 	ImGui::Text("FPS : %.1f", this->fps);
+	ImGui::Checkbox("Render on demand", &this->renderOnDemand);
+	ImGui::SameLine();
+	ImGui::Checkbox("VSync", &this->vsync);
+	ImGui::SliderInt("Frame cap", &this->frameCap, 0, 240, this->frameCap ? "%d fps" : "none");
+	bool tracing = traceEnabled;
+	if (ImGui::Checkbox("Trace", &tracing))
+		setTraceEnabled(tracing);
+	ImGui::SameLine();
+	if (ImGui::Button("Save trace"))
+		writeTrace(TRACE_DEFAULT_PATH);
+	ImGui::Checkbox("Lockstep simulation", &this->lockstep);
+	ImGui::SameLine();
+	ImGui::Text("(%.0f Hz updates)", 1.0 / SIMULATION_STEP);
 	ImGui::Text("Model position : (%.1f, %.1f, %.1f)", this->objectPosition.x, this->objectPosition.y, this->objectPosition.z);
 	ImGui::Text("Camera position : (%.1f, %.1f, %.1f)", this->cameraPos.x, this->cameraPos.y, this->cameraPos.z);
 	ImGui::Text("Camera front : (%.1f, %.1f, %.1f)", this->cameraFront.x, this->cameraFront.y, this->cameraFront.z);
@@ -23,6 +40,13 @@ void	Scop::updateUI()
 	ImGui::Text("Camera up : (%.1f, %.1f, %.1f)", this->cameraUp.x, this->cameraUp.y, this->cameraUp.z);
 	ImGui::Text("Yaw : %.1f", this->yaw);
 	ImGui::Text("Pitch : %.1f", this->pitch);
+	// the render thread owns everything below, the UI shows its last published status
+	const RenderStatus& status = this->renderStatus;
+	const MeshletCullStats& stats = status.cullStats;
+	ImGui::Text("Triangles : %u / %u", stats.renderedTriangles, stats.submittedTriangles);
+	ImGui::Text("Meshlets : %u / %zu (frustum %u, backface %u, occlusion %u)", stats.visibleMeshlets, status.meshletCount,
+		stats.frustumCulled, stats.backfaceCulled, stats.occlusionCulled);
+	ImGui::Text("Stream buffer : %s, %u stalls", status.streamPersistent ? "persistent" : "glBufferSubData", status.streamStalls);
 	// File Dialog
 	if (ImGui::Button("Load 3D Model"))
 		ImGuiFileDialog::Instance()->OpenDialog("ChooseObjDlgKey", "Choose File", ".obj", ".");
@@ -32,12 +56,25 @@ void	Scop::updateUI()
 		if (ImGuiFileDialog::Instance()->IsOk())
 		{
 			std::string filePathName = ImGuiFileDialog::Instance()->GetFilePathName();
-			this->loadObjFile(filePathName.c_str());
+			bool progressive = this->progressiveLoading;
+			this->pendingCommands.push_back([this, filePathName, progressive]() {
+				if (progressive)
+					this->streamObjFile(filePathName.c_str());
+				else
+					this->loadObjFile(filePathName.c_str());
+			});
 		}
 		ImGuiFileDialog::Instance()->Close();
 	}
+	ImGui::SameLine();
+	ImGui::Checkbox("Progressive", &this->progressiveLoading);
+	if (status.streaming)
+		ImGui::ProgressBar(status.streamProgress);
 	if (ImGui::Button("Reset object"))
+	{
 		this->objectPosition = Vec3(0.0f, 0.0f, 0.0f);
+		this->previousObjectPosition = this->objectPosition;
+	}
 	if (ImGui::Button("Reset camera"))
 	{
 		this->yaw = -90.0f;
@@ -46,20 +83,96 @@ void	Scop::updateUI()
 	}
 	ImGui::SliderFloat("Rotation Speed", &this->rotationSpeed, 0.0f, 2.0f);
 	ImGui::Checkbox("Wireframe", &this->showWireframe);
+	ImGui::Checkbox("Dynamic resolution", &this->dynamicResolution);
+	if (this->dynamicResolution)
+		ImGui::SliderFloat("Target GPU time", &this->targetFrameMs, 4.0f, 50.0f, "%.1f ms");
+	// the slider caps the scale picked by dynamic resolution, ### keeps its id when the label changes
+	ImGui::SliderFloat(this->dynamicResolution ? "Max render scale###renderScale" : "Render scale###renderScale",
+		&this->renderScale, RENDER_SCALE_MIN, RENDER_SCALE_MAX, "%.2fx");
+	static const char* sampleLabels[] = { "Off", "2x", "4x", "8x" };
+	int sampleIndex = 0;
+	while ((2 << sampleIndex) <= this->msaaSamples && sampleIndex < 3)
+		sampleIndex++;
+	if (ImGui::BeginCombo("MSAA", sampleLabels[sampleIndex]))
+	{
+		// sample counts the driver does not support are not offered
+		for (int i = 0; i < 4 && (1 << i) <= status.maxSamples; i++)
+			if (ImGui::Selectable(sampleLabels[i], i == sampleIndex))
+				this->msaaSamples = 1 << i;
+		ImGui::EndCombo();
+	}
+	ImGui::Text("Render target : %d x %d (%.2fx), %d samples", status.renderWidth, status.renderHeight, status.renderScale, status.renderSamples);
+	ImGui::Text("GPU frame : %.2f ms", status.gpuMs);
+	if (this->dynamicResolution)
+	{
+		ImGui::SameLine();
+		ImGui::Text("(headroom %.2f ms)", status.headroomMs);
+	}
+	ImGui::Checkbox("Frustum culling", &this->frustumCulling);
+	ImGui::Checkbox("Backface culling", &this->backfaceCulling);
+	if (this->gpuCulling)
+	{
+		if (ImGui::Checkbox("GPU culling", &this->useGpuCulling))
+			this->pendingCommands.push_back([this]() { this->gpuCulling->invalidateDepthPyramid(); });
+		ImGui::Checkbox("Occlusion culling", &this->occlusionCulling);
+	}
 	ImGui::Checkbox("Texture", &this->showTextures);
+	if (status.textureLoading)
+	{
+		ImGui::SameLine();
+		ImGui::ProgressBar(status.textureProgress, ImVec2(-1.0f, 0.0f), "loading");
+	}
 	if (ImGui::Button("Load Texture"))
-		ImGuiFileDialog::Instance()->OpenDialog("ChooseTextureDlgKey", "Choose File", ".bmp", ".");
+		ImGuiFileDialog::Instance()->OpenDialog("ChooseTextureDlgKey", "Choose File", ".bmp,.png,.dds,.ktx2", ".");
 
 	if (ImGuiFileDialog::Instance()->Display("ChooseTextureDlgKey"))
 	{
 		if (ImGuiFileDialog::Instance()->IsOk())
 		{
 			std::string filePathName = ImGuiFileDialog::Instance()->GetFilePathName();
-			this->loadTexture(filePathName.c_str());
+			this->pendingCommands.push_back([this, filePathName]() { this->loadTexture(filePathName.c_str()); });
 		}
 		ImGuiFileDialog::Instance()->Close();
 	}
+	const TextureCacheStats& cacheStats = status.cacheStats;
+	uint lookups = cacheStats.hits + cacheStats.misses;
+	ImGui::Text("Texture cache : %zu textures, %.1f MB, %.0f%% hits, %u evictions", cacheStats.entries, cacheStats.bytes / (1024.0f * 1024.0f),
+		lookups ? 100.0f * cacheStats.hits / lookups : 0.0f, cacheStats.evictions);
+	int budgetMb = static_cast<int>(status.cacheBudget / (1024 * 1024));
+	if (ImGui::SliderInt("Texture budget (MB)", &budgetMb, 16, 2048))
+	{
+		// the slider keeps its value until the render thread publishes the new budget
+		size_t budget = (size_t)budgetMb * 1024 * 1024;
+		this->renderStatus.cacheBudget = budget;
+		this->pendingCommands.push_back([this, budget]() { this->textureCache->setBudget(budget); });
+	}
+	// The counters are atomics and the registry has its own lock, no need to go through the render thread
+	if (ImGui::CollapsingHeader("Memory"))
+	{
+		for (int category = 0; category < MEMORY_CATEGORY_COUNT; category++)
+		{
+			MemoryCategoryStats memory = getMemoryStats(static_cast<MemoryCategory>(category));
+			ImGui::Text("%s : %.1f MB (peak %.1f MB), %zu allocations", memoryCategoryName(static_cast<MemoryCategory>(category)),
+				memory.bytes / (1024.0f * 1024.0f), memory.peakBytes / (1024.0f * 1024.0f), memory.allocations);
+		}
+		std::vector<GpuResourceUsage> gpuUsage;
+		collectGpuUsage(gpuUsage);
+		size_t gpuBytes = 0;
+		for (const GpuResourceUsage& usage : gpuUsage)
+			gpuBytes += usage.bytes;
+		ImGui::Text("GPU : %.1f MB", gpuBytes / (1024.0f * 1024.0f));
+		for (const GpuResourceUsage& usage : gpuUsage)
+			ImGui::BulletText("%s : %.1f MB (%u)", usage.label, usage.bytes / (1024.0f * 1024.0f), usage.count);
+	}
 	ImGui::Checkbox("Light", &this->showLight);
+	ImGui::SameLine();
+	ImGui::Text("(%u/%u shader variants ready)", status.shaderVariantsReady, SHADER_VARIANT_COUNT);
+	if (status.shadersReloading)
+		ImGui::Text("Recompiling shaders...");
+	if (!status.shaderError.empty())
+		ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", status.shaderError.c_str());
+	if (!status.computeShaderError.empty())
+		ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", status.computeShaderError.c_str());
 	ImGui::ColorEdit3("Object Color", &this->objectColor.x);
 	ImGui::ColorEdit3("Light Color", &this->lightColor.x);
 	ImGui::Checkbox("Gradient", &this->showGradient);
@@ -99,269 +212,195 @@ void	Scop::updateUI()
 	ImGui::End();
 
 	ImGui::Render();
-	ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+// A cached texture is used right away, otherwise it is decoded and uploaded in the background
+// and textureID is swapped once the new texture is complete. A cache hit drops any earlier load,
+// it would otherwise replace the texture picked last when it completes.
 void	Scop::loadTexture(const char* filename)
 {
-	glDeleteTextures(1, &this->textureID);
-	this->textureID = 0;
-
-	int	width, height, channels;
-	unsigned char* data = stbi_load(filename, &width, &height, &channels, 0);
-	if (!data)
+	uint texture = this->textureCache->acquire(TextureCache::canonicalPath(filename));
+	if (texture)
 	{
-		std::cerr << "Error: could not load texture" << std::endl;
-		throw std::runtime_error("Error: could not load texture");
+		this->textureLoader->cancel();
+		this->setTexture(texture);
 	}
-
-	glGenTextures(1, &this->textureID);
-	glBindTexture(GL_TEXTURE_2D, this->textureID);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glGenerateMipmap(GL_TEXTURE_2D);
-
-	stbi_image_free(data);
+	else
+		this->textureLoader->request(filename);
 }
 
-void	Scop::loadObjFile(const char* filePathName)
+// Takes over a reference of texture and drops the one of the previous texture
+void	Scop::setTexture(uint texture)
 {
-	std::ifstream objFile(filePathName, std::ios::in);
-
-	if (!objFile.is_open())
-	{
-		std::cerr << "Error: could not open file" << std::endl;
-		throw std::runtime_error("Error: could not open file");
-	}
-
-	glDeleteBuffers(1, &this->VBO);
-	glDeleteBuffers(1, &this->EBO);
-	glDeleteVertexArrays(1, &this->VAO);
-	glDeleteBuffers(1, &this->textureVBO);
-	glDeleteBuffers(1, &this->normalVBO);
-
-	this->vertex_postitions.clear();
-	this->vertex_texcoords.clear();
-	this->vertex_normals.clear();
-	this->indices.clear();
-
-	std::vector<uint> vertexIndices, uvIndices, normalIndices;
-	std::vector<Vec3> temp_vertices, out_vertices;
-	std::vector<TextureCoord> temp_uvs, out_uvs;
-	std::vector<Vec3> temp_normals, out_normals;
-
-	std::string line;
-	while (std::getline(objFile, line))
-	{
-		std::istringstream iss(line);
-		std::string type;
-		iss >> type;
-
-		if (type == "v")
-		{
-			Vec3 vertex;
-			iss >> vertex.x >> vertex.y >> vertex.z;
-			temp_vertices.push_back(vertex);
-		}
-		else if (type == "vt")
-		{
-			TextureCoord texture;
-			iss >> texture.u >> texture.v;
-			temp_uvs.push_back(texture);
-		}
-		else if (type == "vn")
-		{
-			Vec3 normal;
-			iss >> normal.x >> normal.y >> normal.z;
-			temp_normals.push_back(normal);
-		}
-		else if (type == "f")
-		{
-			uint vp_index[3], vt_index[3], vn_index[3];
-			std::string token;
-
-			for (uint i = 0; i < 3; i++)
-			{
-				iss >> token;
-
-				std::istringstream tokenStream(token);
-				std::string indexToken;
-
-				getline(tokenStream, indexToken, '/');
-				if (!indexToken.empty())
-					vp_index[i] = std::stoi(indexToken) - 1;
-
-				if (getline(tokenStream, indexToken, '/') && !indexToken.empty())
-					vt_index[i] = std::stoi(indexToken) - 1;
-
-				if (getline(tokenStream, indexToken, '/') && !indexToken.empty())
-					vn_index[i] = std::stoi(indexToken) - 1;
-			}
-
-			vertexIndices.push_back(vp_index[0]);
-			vertexIndices.push_back(vp_index[1]);
-			vertexIndices.push_back(vp_index[2]);
-
-			uvIndices.push_back(vt_index[0]);
-			uvIndices.push_back(vt_index[1]);
-			uvIndices.push_back(vt_index[2]);
-
-			normalIndices.push_back(vn_index[0]);
-			normalIndices.push_back(vn_index[1]);
-			normalIndices.push_back(vn_index[2]);
-
-			if (iss >> token)
-			{
-				vertexIndices.push_back(vp_index[0]);
-				vertexIndices.push_back(vp_index[2]);
-				vertexIndices.push_back(std::stoi(token) - 1);
-
-				uvIndices.push_back(vt_index[0]);
-				uvIndices.push_back(vt_index[2]);
-				uvIndices.push_back(std::stoi(token) - 1);
-
-				normalIndices.push_back(vn_index[0]);
-				normalIndices.push_back(vn_index[2]);
-				normalIndices.push_back(std::stoi(token) - 1);
-			}
-		}
-	}
-	objFile.close();
-
-	for (uint i = 0; i < vertexIndices.size(); i++)
-	{
-		uint vertexIndex = vertexIndices[i];
-		uint uvIndex = uvIndices[i];
-		uint normalIndex = normalIndices[i];
-
-		Vec3 vertex = temp_vertices[vertexIndex];
-		out_vertices.push_back(vertex);
-
-		if (temp_uvs.size() > 0 && temp_normals.size() > 0)
-		{
-			TextureCoord texture = temp_uvs[uvIndex];
-			Vec3 normal = temp_normals[normalIndex];
-
-			out_uvs.push_back(texture);
-			out_normals.push_back(normal);
-		}
-	}
-
-	if (out_uvs.size() == 0)
-	{
-		for (uint i = 0; i < out_vertices.size(); i += 6)
-		{
-			out_uvs.push_back({ 0.0f, 0.0f });
-			out_uvs.push_back({ 0.0f, 1.0f });
-			out_uvs.push_back({ 1.0f, 1.0f });
+	this->textureCache->release(this->textureID);
+	this->textureID = texture;
+}
 
-			out_uvs.push_back({ 0.0f, 0.0f });
-			out_uvs.push_back({ 1.0f, 1.0f });
-			out_uvs.push_back({ 1.0f, 0.0f });
-		}
-	}
+// Upload the materials of the mesh, their textures are packed into arrays that define the draw batches.
+// appendMeshlets: the meshlets only grew since the last call (streaming), the new ones are uploaded alone.
+void	Scop::updateMaterials(bool appendMeshlets)
+{
+	TRACE_SCOPE("updateMaterials");
+	std::vector<GpuMaterial> gpuMaterials;
 
-	if (out_normals.size() == 0)
-	{
-		for (uint i = 0; i < out_vertices.size(); i += 3)
-		{
-			Vec3 v0 = out_vertices[i];
-			Vec3 v1 = out_vertices[i + 1];
-			Vec3 v2 = out_vertices[i + 2];
+	this->materialTextures.update(this->mesh.materials, gpuMaterials, this->materialBatches);
 
-			Vec3 edge1 = v1 - v0;
-			Vec3 edge2 = v2 - v0;
+	glBindBuffer(GL_UNIFORM_BUFFER, this->materialUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, gpuMaterials.size() * sizeof(GpuMaterial), gpuMaterials.data());
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
 
-			Vec3 normal = Vec3::cross(edge1, edge2);
+	if (this->gpuCulling && appendMeshlets)
+		this->gpuCulling->appendMeshlets(this->mesh.meshlets, this->materialBatches);
+	else if (this->gpuCulling)
+		this->gpuCulling->uploadMeshlets(this->mesh.meshlets, this->materialBatches);
+}
 
-			normal = Vec3::normalize(normal);
+void	Scop::loadObjFile(const char* filePathName)
+{
+	TRACE_SCOPE("loadObjFile");
+	resetMemoryPeaks();
+	Mesh loaded;
+	loadObjMesh(filePathName, loaded);
+	buildMeshlets(loaded.positions, loaded.indices, loaded.materialRanges, loaded.meshlets);
 
-			out_normals.push_back(normal);
-			out_normals.push_back(normal);
-			out_normals.push_back(normal);
-		}
-	}
+	this->objStream.reset();
 
-	indexVBO(out_vertices, out_uvs, out_normals);
+	this->mesh = std::move(loaded);
 	createBuffersAndArrays();
+	this->materialTextures.clear();
+	this->updateMaterials();
+	setMemoryUsage(MEMORY_MESH, this->mesh.memoryBytes());
 }
 
-bool	getSimilarVertexIndex(PackedVertex &packed, std::map<PackedVertex, ushort> &VertexToOutIndex, ushort &result)
+// Immutable storage is only reallocated when the data does not fit, the used part is kept
+static void	reserveBuffer(uint& buffer, GLsizeiptr& capacity, GLsizeiptr used, GLsizeiptr size, const char* label)
 {
-	std::map<PackedVertex, ushort>::iterator it = VertexToOutIndex.find(packed);
-	if (it == VertexToOutIndex.end())
-		return false;
+	if (buffer != 0 && size <= capacity)
+		return;
+
+	uint previous = buffer;
+	capacity = std::max(std::max(size, capacity + capacity / 2), (GLsizeiptr)1);
+	glGenBuffers(1, &buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+	if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage)
+		glBufferStorage(GL_COPY_WRITE_BUFFER, capacity, nullptr, 0);
 	else
-	{
-		result = it->second;
-		return true;
-	}
-}
-
-void	Scop::indexVBO(std::vector<Vec3> &in_vertices, std::vector<TextureCoord> &in_uvs, std::vector<Vec3> &in_normals)
-{
-	std::map<PackedVertex, ushort> vertexToOutIndex;
+		glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
 
-	for (uint i = 0; i < in_vertices.size(); i++)
+	if (previous != 0 && used > 0)
 	{
-		PackedVertex packed = { in_vertices[i], in_uvs[i], in_normals[i] };
-
-		ushort index;
-		bool found = getSimilarVertexIndex(packed, vertexToOutIndex, index);
-
-		if (found)
-			this->indices.push_back(index);
-		else
-		{
-			this->vertex_postitions.push_back(in_vertices[i]);
-			this->vertex_texcoords.push_back(in_uvs[i]);
-			this->vertex_normals.push_back(in_normals[i]);
-
-			ushort newIndex = static_cast<ushort>(this->vertex_postitions.size() - 1);
-			this->indices.push_back(newIndex);
-			vertexToOutIndex[packed] = newIndex;
-		}
+		glBindBuffer(GL_COPY_READ_BUFFER, previous);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
 	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	glDeleteBuffers(1, &previous);
+	untrackGpuResource(GPU_BUFFER, previous);
+	trackGpuResource(GPU_BUFFER, buffer, label, capacity);
 }
 
 void	Scop::createBuffersAndArrays()
 {
-	// Generate Vertex Array Object
-	glGenVertexArrays(1, &this->VAO);
-	glBindVertexArray(VAO);
+	TRACE_SCOPE("createBuffersAndArrays");
+	this->vertexCount = 0;
+	this->indexCount = 0;
+	this->appendGeometry(this->mesh);
+}
 
-	// Generate and bind the VBO for positions
-	glGenBuffers(1, &this->VBO);
+// Append vertices and indices after the ones already uploaded, part indices must already be global
+void	Scop::appendGeometry(const Mesh& part)
+{
+	uint partVertices = static_cast<uint>(part.positions.size());
+	uint partIndices = static_cast<uint>(part.indices.size());
+
+	reserveBuffer(this->VBO, this->VBOCapacity, this->vertexCount * sizeof(Vec3), (this->vertexCount + partVertices) * sizeof(Vec3), "positions");
+	reserveBuffer(this->textureVBO, this->textureVBOCapacity, this->vertexCount * sizeof(TextureCoord), (this->vertexCount + partVertices) * sizeof(TextureCoord), "texcoords");
+	reserveBuffer(this->normalVBO, this->normalVBOCapacity, this->vertexCount * sizeof(Vec3), (this->vertexCount + partVertices) * sizeof(Vec3), "normals");
+	reserveBuffer(this->EBO, this->EBOCapacity, this->indexCount * sizeof(uint), (this->indexCount + partIndices) * sizeof(uint), "indices");
+
+	// Geometry goes through the stream buffer, no glBufferData stall on reload
+	this->streamBuffer->copyToBuffer(this->VBO, this->vertexCount * sizeof(Vec3), part.positions.data(), partVertices * sizeof(Vec3));
+	this->streamBuffer->copyToBuffer(this->textureVBO, this->vertexCount * sizeof(TextureCoord), part.texcoords.data(), partVertices * sizeof(TextureCoord));
+	this->streamBuffer->copyToBuffer(this->normalVBO, this->vertexCount * sizeof(Vec3), part.normals.data(), partVertices * sizeof(Vec3));
+	this->streamBuffer->copyToBuffer(this->EBO, this->indexCount * sizeof(uint), part.indices.data(), partIndices * sizeof(uint));
+	this->vertexCount += partVertices;
+	this->indexCount += partIndices;
+
+	// The Vertex Array Object is created once and re-pointed at the buffers
+	if (this->VAO == 0)
+		glGenVertexArrays(1, &this->VAO);
+	glBindVertexArray(this->VAO);
+
+	// Positions
 	glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
-	glBufferData(GL_ARRAY_BUFFER, this->vertex_postitions.size() * sizeof(Vec3), this->vertex_postitions.data(), GL_STATIC_DRAW);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3), (void*)0);
 	glEnableVertexAttribArray(0);
 
-	// Generate and bind the VBO for texture coordinates
-	glGenBuffers(1, &this->textureVBO);
+	// Texture coordinates
 	glBindBuffer(GL_ARRAY_BUFFER, this->textureVBO);
-	glBufferData(GL_ARRAY_BUFFER, this->vertex_texcoords.size() * sizeof(TextureCoord), this->vertex_texcoords.data(), GL_STATIC_DRAW);
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(TextureCoord), (void*)0);
 	glEnableVertexAttribArray(1);
 
-	// Generate and bind the VBO for normals
-	glGenBuffers(1, &this->normalVBO);
+	// Normals
 	glBindBuffer(GL_ARRAY_BUFFER, this->normalVBO);
-	glBufferData(GL_ARRAY_BUFFER, this->vertex_normals.size() * sizeof(Vec3), this->vertex_normals.data(), GL_STATIC_DRAW);
 	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vec3), (void*)0);
 	glEnableVertexAttribArray(2);
 
-	// Generate and bind the EBO for indices
-	glGenBuffers(1, &this->EBO);
+	// Material index, one per instance
+	glBindBuffer(GL_ARRAY_BUFFER, this->materialIdVBO);
+	glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(uint), (void*)0);
+	glVertexAttribDivisor(3, 1);
+	glEnableVertexAttribArray(3);
+
+	// Indices
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->indices.size() * sizeof(uint), this->indices.data(), GL_STATIC_DRAW);
 
 	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-	this->cameraTarget = calculateModelCenterOffset();
+void	Scop::streamObjFile(const char* filePathName)
+{
+	resetMemoryPeaks();
+	this->objStream = std::make_unique<ObjStream>(filePathName);
+	this->mesh.clear();
+	this->vertexCount = 0;
+	this->indexCount = 0;
+	this->materialTextures.clear();
+	this->updateMaterials();
+	setMemoryUsage(MEMORY_MESH, this->mesh.memoryBytes());
+}
+
+// Parse, cluster and upload the next window; only the window is kept on the host
+void	Scop::streamNextWindow()
+{
+	TRACE_SCOPE("streamNextWindow");
+	uint baseVertex = this->vertexCount;
+	uint baseIndex = this->indexCount;
+
+	this->objStream->readWindow(this->streamWindow, OBJ_STREAM_WINDOW_TRIANGLES);
+	buildMeshlets(this->streamWindow.positions, this->streamWindow.indices, this->streamWindow.materialRanges, this->streamWindow.meshlets);
+
+	for (uint& index : this->streamWindow.indices)
+		index += baseVertex;
+	for (Meshlet& meshlet : this->streamWindow.meshlets)
+	{
+		meshlet.firstIndex += baseIndex;
+		this->mesh.meshlets.push_back(meshlet);
+	}
+
+	this->appendGeometry(this->streamWindow);
+	this->mesh.mergeBounds(this->streamWindow);
+	// The stream's material list only grows, textures already loaded are reused
+	this->mesh.materials = this->objStream->getMaterials();
+	this->updateMaterials(true);
+
+	if (this->objStream->done())
+	{
+		this->objStream.reset();
+		this->streamWindow = Mesh();
+	}
+	setMemoryUsage(MEMORY_MESH, this->mesh.memoryBytes() + this->streamWindow.memoryBytes());
 }
 
 float	Scop::toRadians(float degrees)